@@ -0,0 +1,119 @@
+/*
+ *   ADCSCAN.C -- Background ADC scan and filter bank; see adcscan.h
+ */
+
+#include "adcscan.h"
+#include "hal_ext.h"
+#include "../inc/hal_robo.h"
+
+struct adc_chan
+{
+    INT16U sum;                         // conversions since the last filter input
+    INT8U  n;
+    INT8U  type, k;
+    INT8U  head;                        // hist[head] is the newest input
+    INT16U hist[ADC_BOXCAR];
+    INT16U box;                         // sum of hist[]
+    INT16U iir;                         // << ADC_IIR_FRAC
+    INT16U out;
+};
+
+static struct adc_chan chan[ADC_NCH];
+
+static INT16U median3(INT16U a, INT16U b, INT16U c)
+{
+    if (a > b) {
+        INT16U t = a;
+        a = b;
+        b = t;
+    }
+    return c < a ? a : c > b ? b : c;
+}
+
+static void filter_input(struct adc_chan *c, INT16U x)
+{
+    INT8U h = (c->head + 1) & (ADC_BOXCAR - 1);
+
+    c->box += x - c->hist[h];
+    c->hist[h] = x;
+    c->head = h;
+
+    switch (c->type)
+    {
+        case ADC_FILT_BOXCAR:
+            c->out = c->box / ADC_BOXCAR;
+            break;
+        case ADC_FILT_MEDIAN3:
+            c->out = median3(x, c->hist[(h - 1) & (ADC_BOXCAR - 1)], c->hist[(h - 2) & (ADC_BOXCAR - 1)]);
+            break;
+        case ADC_FILT_IIR:
+            c->iir += ((INT16S)((x << ADC_IIR_FRAC) - c->iir)) >> c->k;
+            c->out = c->iir >> ADC_IIR_FRAC;
+            break;
+        default:
+            c->out = x;
+            break;
+    }
+}
+
+void adcscan_isr(INT8U ch, INT16U v)
+{
+    struct adc_chan *c = &chan[ch];
+
+    c->sum += v;
+    if (++c->n == 1 << ADC_OVERSAMPLE_SHIFT) {
+        filter_input(c, c->sum >> ADC_OVERSAMPLE_SHIFT);
+        c->sum = 0;
+        c->n = 0;
+    }
+}
+
+/* Starts the channel's filter from its current output */
+static void prime(struct adc_chan *c, INT16U v)
+{
+    INT8U i;
+
+    for (i = 0; i < ADC_BOXCAR; i++)
+        c->hist[i] = v;
+    c->box = v * ADC_BOXCAR;
+    c->iir = v << ADC_IIR_FRAC;
+    c->out = v;
+    c->sum = 0;
+    c->n = 0;
+}
+
+void adcscan_filter(INT8U ch, INT8U type, INT8U k)
+{
+    unsigned char sreg = hal_irq_save();
+
+    chan[ch].type = type;
+    chan[ch].k = k;
+    prime(&chan[ch], chan[ch].out);
+    hal_irq_restore(sreg);
+}
+
+INT16U adcscan_read(INT8U ch)
+{
+    unsigned char sreg = hal_irq_save();
+    INT16U v = chan[ch].out;
+
+    hal_irq_restore(sreg);
+    return v;
+}
+
+void adcscan_set(INT8U ch, INT16U v)
+{
+    unsigned char sreg = hal_irq_save();
+
+    chan[ch].out = v;
+    hal_irq_restore(sreg);
+}
+
+void adcscan_init(void)
+{
+    INT8U ch;
+
+    for (ch = 0; ch < ADC_NCH; ch++)
+        prime(&chan[ch], ADC_read(ch));
+    hal_adc_scan_start();
+}
@@ -0,0 +1,41 @@
+/*
+ *   ADCSCAN.H -- Background ADC scan with a per-channel filter bank
+ *
+ *   Once hal_adc_scan_start() is called, the 1 ms Timer2 interrupt starts
+ *   a round of conversions of channels 0-5 at clk/128, 104 us each, and
+ *   the ADC interrupt hands every result to adcscan_isr().  That sums
+ *   1 << ADC_OVERSAMPLE_SHIFT conversions of a channel, 4 ms worth, and
+ *   passes their mean through the channel's filter:
+ *
+ *       ADC_FILT_NONE      the mean as it is
+ *       ADC_FILT_BOXCAR    mean of the last ADC_BOXCAR means
+ *       ADC_FILT_MEDIAN3   median of the last three means; one bad one is dropped
+ *       ADC_FILT_IIR       y += (x - y) >> k, y kept in 1/32 counts
+ *
+ *   adcscan_read() then only copies the channel's last output, so a task
+ *   never waits for a conversion.  While the scan runs the HAL's
+ *   ADC_read() must not be called, robo_lineSensor(), robo_lightSensor()
+ *   and robo_proxSensor() included: it would fight the ISR for ADMUX.
+ */
+
+#ifndef ADCSCAN_H
+#define ADCSCAN_H
+
+#include "../inc/kernel.h"
+
+#define ADC_NCH             6           // prox, line L/M/R, light, battery
+#define ADC_PROX            0
+#define ADC_PROX_NEAR       100         // robo_proxSensor's: an obstacle reads lower
+#define ADC_OVERSAMPLE_SHIFT 2          // 4 conversions per filter input
+#define ADC_BOXCAR          4           // filter inputs, power of two
+#define ADC_IIR_FRAC        5
+
+enum { ADC_FILT_NONE, ADC_FILT_BOXCAR, ADC_FILT_MEDIAN3, ADC_FILT_IIR };
+
+void   adcscan_init(void);              // one plain read per channel, then the scan, all ADC_FILT_NONE
+void   adcscan_filter(INT8U ch, INT8U type, INT8U k);  // k: ADC_FILT_IIR shift
+INT16U adcscan_read(INT8U ch);          // filtered ADC counts
+void   adcscan_set(INT8U ch, INT16U v); // overrides the filter output until the next input; sim replay
+void   adcscan_isr(INT8U ch, INT16U v); // from ADC_vect only
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ *   CALIB.C -- Wheel deadband and gain calibration; see calib.h
+ */
+
+#include "calib.h"
+#include "drive.h"
+#include "linesens.h"
+#include "hal_ext.h"
+#include "telemetry.h"
+
+/* Up to ms for two samples in a row that are (centred) or are not code 2 */
+static char wait_line(char centred, INT16U ms)
+{
+    INT32U t0 = hal_millis();
+    INT8U  n = 0;
+
+    while (hal_millis() - t0 < ms) {
+        OSTimeDly(1);
+        if ((tlm_lineSensor() == 2) == centred) {
+            if (++n == 2)
+                return 1;
+        } else {
+            n = 0;
+        }
+    }
+    return 0;
+}
+
+/* Pivot by dir (+1 right) for ms, reading the line every tick so linesens.c sees it */
+static void pivot(int dir, INT16U ms)
+{
+    INT32U t0 = hal_millis();
+
+    while (hal_millis() - t0 < ms) {
+        drive_tick(dir * CAL_SWEEP_SPEED, -dir * CAL_SWEEP_SPEED);
+        tlm_lineSensor();
+        OSTimeDly(1);
+    }
+}
+
+static char sweep_line(void)
+{
+    linesens_forget();
+    pivot(1, CAL_SWEEP_MS);
+    pivot(-1, 2 * CAL_SWEEP_MS);
+    pivot(1, CAL_SWEEP_MS);
+    while (drive_left() || drive_right()) {
+        drive_tick(0, 0);
+        tlm_lineSensor();
+        OSTimeDly(1);
+    }
+    if (!linesens_valid())
+        return 0;
+    linesens_save();
+    return 1;
+}
+
+/* Raw PWM; -1 if the robot did not get back onto the line */
+static int find_deadband(int m)
+{
+    int  pwm;
+    char centred;
+
+    for (pwm = CAL_DEAD_FIRST; ; pwm++) {
+        drive_raw(m, pwm);
+        if (wait_line(0, CAL_HOLD_MS))
+            break;
+        if (pwm == CAL_DEAD_LAST) {
+            drive_raw(m, 0);
+            return 0;
+        }
+    }
+    drive_raw(m, -pwm);                 // pivot back the way it came
+    centred = wait_line(1, CAL_BACK_MS);
+    drive_raw(m, 0);
+    if (!centred)
+        return -1;
+    return pwm > CAL_DEAD_BACKOFF ? pwm - CAL_DEAD_BACKOFF : 0;
+}
+
+/* Mean trim over the second half, in 1/16 speed units, + = left faster; 0 if the line was lost */
+static char find_trim(int *trim_avg)
+{
+    INT32U t0 = hal_millis(), now;
+    INT32S sum = 0;
+    int    trim = 0, n = 0;
+    char   ok = 1;
+
+    while ((now = hal_millis()) - t0 < CAL_TRIM_MS) {
+        int code = tlm_lineSensor(), side, t;
+
+        if (code == 3 || code == 1)
+            side = 1;                   // line to the right: steer right
+        else if (code == 6 || code == 4)
+            side = -1;
+        else if (code == 0) {
+            ok = 0;
+            break;
+        } else
+            side = 0;
+        trim += side;
+        t = trim / 16 + side * CAL_KP;
+        drive_tick(CAL_SPEED + t, CAL_SPEED - t);
+        if (now - t0 >= CAL_TRIM_MS / 2) {
+            sum += trim;
+            n++;
+        }
+        OSTimeDly(1);
+    }
+    while (drive_left() || drive_right()) {
+        drive_tick(0, 0);
+        OSTimeDly(1);
+    }
+    if (!ok || n == 0)
+        return 0;
+    *trim_avg = sum / n;
+    return 1;
+}
+
+char calib_run(void)
+{
+    struct drive_cal old, c;
+    int dl, dr, trim;
+    INT16S dg;
+
+    drive_get_cal(&old);
+    if (!wait_line(1, 1000))
+        return 0;
+    if (!sweep_line() || !wait_line(1, 1000))
+        return 0;
+    if ((dl = find_deadband(WHEEL_L)) < 0 || (dr = find_deadband(WHEEL_R)) < 0)
+        return 0;
+
+    c.dead[WHEEL_L] = dl;
+    c.dead[WHEEL_R] = dr;
+    c.gain[WHEEL_L] = c.gain[WHEEL_R] = DRIVE_GAIN_ONE;
+    drive_set_cal(&c);
+    if (!find_trim(&trim)) {
+        drive_set_cal(&old);
+        return 0;
+    }
+
+    dg = (INT32S)trim * DRIVE_GAIN_ONE / (16 * CAL_SPEED);
+    if (dg > CAL_GAIN_MAXDIFF || dg < -CAL_GAIN_MAXDIFF)
+        dg = dg > 0 ? CAL_GAIN_MAXDIFF : -CAL_GAIN_MAXDIFF;
+    c.gain[WHEEL_L] = DRIVE_GAIN_ONE + dg;
+    c.gain[WHEEL_R] = DRIVE_GAIN_ONE - dg;
+    drive_set_cal(&c);
+    drive_save_cal();
+    return 1;
+}
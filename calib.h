@@ -0,0 +1,42 @@
+/*
+ *   CALIB.H -- Line sensor, wheel deadband and gain calibration
+ *
+ *   Hold the go button at power-on with the robot centred on a straight
+ *   of at least 1 m.  calib_run() then:
+ *
+ *   1. pivots right, left and back over the line, CAL_SWEEP_MS a quarter,
+ *      so linesens.c sees line and floor under every sensor.
+ *   2. raises each wheel's PWM from CAL_DEAD_FIRST one step every
+ *      CAL_HOLD_MS, the other wheel stopped, until the robot has pivoted
+ *      far enough for the line to leave the middle sensor.  That step,
+ *      less CAL_DEAD_BACKOFF for the creep before the sensor saw it, is
+ *      the wheel's deadband.  The wheel then backs onto the line again.
+ *   3. follows the line at CAL_SPEED for CAL_TRIM_MS with a slow integral
+ *      trim between the wheels.  The trim it settles on over the second
+ *      half is the gain mismatch.
+ *
+ *   The results go to EEPROM through linesens_save() and drive_save_cal()
+ *   and are used from then on.  It returns 0 when the robot was not on the
+ *   line at the start, a sensor saw no contrast, or the line was lost; the
+ *   wheel calibration is then left as it was.  A sweep that worked is
+ *   kept even so.
+ */
+
+#ifndef CALIB_H
+#define CALIB_H
+
+#define CAL_SWEEP_SPEED     30
+#define CAL_SWEEP_MS        250
+#define CAL_DEAD_FIRST      3           // motor_set_speed values
+#define CAL_DEAD_LAST       40          // never moved by here: leave it uncompensated
+#define CAL_DEAD_BACKOFF    2
+#define CAL_HOLD_MS         400
+#define CAL_BACK_MS         3000        // at most, to get back onto the line
+#define CAL_SPEED           40
+#define CAL_KP              4           // speed units on a side code
+#define CAL_TRIM_MS         4000
+#define CAL_GAIN_MAXDIFF    40          // drive_cal gain from DRIVE_GAIN_ONE, about 30 %
+
+char calib_run(void);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ *   CHECKPOINT.C -- Full-bar detector; see checkpoint.h
+ */
+
+#include "checkpoint.h"
+#include "hal_ext.h"
+#include "trackmap.h"
+
+static char   in_bar;
+static INT8U  run;                      // consecutive samples towards entry or exit
+static int    before;                   // last code before the bar
+static INT32U t_entry;
+static INT32U t_counted;
+static char   have_counted;
+static unsigned char pending;           // confidence of a bar not yet taken
+
+/* Points for the line code next to the bar; the exit also accepts the end of the tape */
+static signed char side_score(int code, char exit)
+{
+    switch (code)
+    {
+        case 2:         return 30;
+        case 3: case 6: return 20;
+        case 1: case 4: return 5;
+        case 0:         return exit ? 10 : 0;
+        case 5:         return -20;     // two lines under the outer sensors: a fork
+        default:        return 0;
+    }
+}
+
+/* Side of the robot the line is on: 1 left, -1 right, 0 centred or none */
+static signed char side(int code)
+{
+    switch (code)
+    {
+        case 4: case 6: return 1;
+        case 1: case 3: return -1;
+        default:        return 0;
+    }
+}
+
+static unsigned char confidence(int after, INT32U now)
+{
+    int conf = 40 + side_score(before, 0) + side_score(after, 1);
+
+    if (side(before) * side(after) < 0)     // the line crossed under the robot: a branch
+        conf -= 20;
+    if (now - t_entry > CHK_LONG_MS)
+        conf -= 20;
+    if (have_counted && (now - t_counted < CHK_MIN_GAP_MS || trackmap_dist() < CHK_MIN_DIST))
+        conf = 1;
+    return conf < 1 ? 1 : conf;
+}
+
+void checkpoint_sample(int code)
+{
+    INT32U now = hal_millis();
+
+    if (!in_bar) {
+        if (code != 7) {
+            before = code;
+            run = 0;
+        } else if (++run == CHK_ENTRY) {
+            in_bar = 1;
+            run = 0;
+            t_entry = now;
+        }
+    } else if (code == 7) {
+        run = 0;
+    } else if (++run == CHK_EXIT) {
+        unsigned char conf = confidence(code, now);
+
+        in_bar = 0;
+        run = 0;
+        if (conf > pending)             // two bars before Navig looks: keep the likelier one
+            pending = conf;
+        if (CHK_COUNTED(conf)) {
+            have_counted = 1;
+            t_counted = now;
+        }
+        before = code;
+    }
+}
+
+/* Highest confidence of the bars that ended since the last call, 0 if none */
+unsigned char checkpoint_bar(void)
+{
+    unsigned char conf = pending;
+
+    pending = 0;
+    return conf;
+}
@@ -0,0 +1,33 @@
+/*
+ *   CHECKPOINT.H -- Full-bar detector for the checkpoint state machine
+ *
+ *   Every line-sensor sample goes through checkpoint_sample().  A bar
+ *   starts after CHK_ENTRY consecutive all-on samples and ends after
+ *   CHK_EXIT consecutive other ones, so a bar seen for many samples is one
+ *   bar and a single dropout in the middle does not split it.  When it
+ *   ends it gets a confidence from how the robot came onto it and left it
+ *   (centred on the line before and after scores high, a sharp correction
+ *   either side scores low, a fork next to it or the line leaving on the
+ *   other side than it came scores lower still) and from how long it
+ *   lasted.  A bar within CHK_MIN_GAP_MS or CHK_MIN_DIST of the
+ *   last counted one scores 1.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "../inc/kernel.h"
+
+#define CHK_ENTRY           2           // all-on samples to enter a bar
+#define CHK_EXIT            2           // other samples to leave it
+#define CHK_LONG_MS         300         // longer than a bar crossed at speed
+#define CHK_MIN_GAP_MS      500         // from the last counted bar
+#define CHK_MIN_DIST        150         // trackmap_dist() units, ~10 cm
+#define CHK_MIN_CONF        60          // confidence a bar needs to count
+
+#define CHK_COUNTED(conf)   ((conf) >= CHK_MIN_CONF)
+
+void          checkpoint_sample(int code);
+unsigned char checkpoint_bar(void);
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ *   DELAY.H -- Task delays in milliseconds, converted to ticks at compile time
+ *
+ *   OSTimeDlyHMSM() checks and converts its h/m/s/ms at run time, with
+ *   32-bit multiplies and __udivmodsi4, on every call.  Given a constant,
+ *   MS_TO_TICKS() folds to a number instead.  It rounds to the nearest
+ *   tick like OSTimeDlyHMSM(), so the delays do not change, and likewise
+ *   DELAY_MS() of under half a tick does not wait at all.  Up to 655 s at
+ *   100 ticks/s; a variable argument still divides at run time.
+ */
+
+#ifndef DELAY_H
+#define DELAY_H
+
+#include "../inc/kernel.h"
+
+#define MS_TO_TICKS(ms)     ((INT16U)(((INT32U)(ms) * OS_TICKS_PER_SEC + 500UL) / 1000UL))
+#define DELAY_MS(ms)        OSTimeDly(MS_TO_TICKS(ms))
+
+#endif
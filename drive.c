@@ -0,0 +1,253 @@
+/*
+ *   DRIVE.C -- Slew-limited wheel output; see drive.h
+ */
+
+#include "drive.h"
+#include "hal_ext.h"
+#include "telemetry.h"
+#include "adcscan.h"
+
+#define DRIVE_CAL_MAGIC     0x4443      // "DC"; bump when struct drive_cal changes
+#define DRIVE_LOG           8           // changes drive_isr() queues for drive_report(), power of two
+
+static int  accel_lim, decel_lim;
+static int  out[2];                     // written by drive_isr() once started
+static volatile int target[2];
+static volatile char running;
+static char rev[2];                     // direction last written; 1 = reverse
+static INT8U gain = DRIVE_GAIN_ONE;     // one byte, so the tick never sees half an update
+static INT8U gain_written = DRIVE_GAIN_ONE;
+static struct drive_cal cal;
+
+#ifdef TELEMETRY
+static struct
+{
+    INT32U ms;
+    signed char l, r;
+} changes[DRIVE_LOG];
+static volatile INT8U chg_head, chg_tail;
+
+/* Interrupts off; when full the newest change is overwritten, so the last one always shows */
+static void queue_change(void)
+{
+    INT8U i;
+
+    if ((INT8U)(chg_head - chg_tail) == DRIVE_LOG)
+        chg_head--;
+    i = chg_head & (DRIVE_LOG - 1);
+    changes[i].ms = hal_tick_millis();
+    changes[i].l  = out[WHEEL_L];
+    changes[i].r  = out[WHEEL_R];
+    chg_head++;
+}
+#endif
+
+static int slew(int cur, int target)
+{
+    if (cur > 0 && target < cur) {      // slowing down going forward
+        if (target < 0)
+            target = 0;                 // rest at zero before reversing
+        return cur - decel_lim > target ? cur - decel_lim : target;
+    }
+    if (cur < 0 && target > cur) {      // slowing down in reverse
+        if (target > 0)
+            target = 0;
+        return cur + decel_lim < target ? cur + decel_lim : target;
+    }
+    if (target > cur)
+        return cur + accel_lim < target ? cur + accel_lim : target;
+    return cur - accel_lim > target ? cur - accel_lim : target;
+}
+
+/* The limiter has held a reversing wheel at zero for the last tick */
+static void write_pwm(int m, char r, int pwm)
+{
+    if (pwm != 0 && r != rev[m]) {
+        hal_motor_dir(m, r);
+        rev[m] = r;
+    }
+    motor_set_speed(m, pwm > 100 ? 100 : pwm);
+}
+
+/* The battery gain goes last: the deadband was calibrated in PWM at about
+   DRIVE_VBAT_MV, and a sagging pack needs more PWM to start a wheel too */
+static void write_wheel(int m, int speed, INT8U g)
+{
+    char r = speed < 0;
+    int  pwm = (INT32S)(r ? -speed : speed) * cal.gain[m] / DRIVE_GAIN_ONE;
+
+    if (pwm > 0)
+        pwm = cal.dead[m] + pwm * (100 - cal.dead[m]) / 100;
+    write_pwm(m, r, (INT32S)pwm * g / DRIVE_GAIN_ONE);
+}
+
+/* Sets the gain the limiter applies from the next tick on; returns the pack in mV */
+static INT16U read_battery(INT16U adc)
+{
+    INT16U mv, g;
+
+    mv = (INT32U)adc * DRIVE_BATT_FULL_MV / 1023;
+    g  = mv ? (INT32U)DRIVE_VBAT_MV * DRIVE_GAIN_ONE / mv : DRIVE_GAIN_MAX;
+
+    if (g < DRIVE_GAIN_MIN)
+        g = DRIVE_GAIN_MIN;
+    if (g > DRIVE_GAIN_MAX)
+        g = DRIVE_GAIN_MAX;
+    gain = g;
+    return mv;
+}
+
+void drive_init(int accel, int decel)
+{
+    accel_lim = accel;
+    decel_lim = decel;
+    robo_motorSpeed(0, 0);              // both wheels forward, stopped
+    out[WHEEL_L] = out[WHEEL_R] = 0;
+    rev[WHEEL_L] = rev[WHEEL_R] = 0;
+    read_battery(adcscan_read(DRIVE_ADC_BATT));     // before tlm_start(); not reported yet
+    hal_eeprom_read(EE_DRIVECAL, &cal, sizeof(cal));
+    if (cal.magic != DRIVE_CAL_MAGIC)
+        drive_set_cal(0);
+}
+
+/* One tick of the limiter; 0 if neither output changed */
+static char step(int ltarget, int rtarget)
+{
+    int l = slew(out[WHEEL_L], ltarget);
+    int r = slew(out[WHEEL_R], rtarget);
+    INT8U g = gain;
+
+    if (l == out[WHEEL_L] && r == out[WHEEL_R] && g == gain_written)
+        return 0;
+    if (l != out[WHEEL_L] || g != gain_written)
+        write_wheel(WHEEL_L, l, g);
+    if (r != out[WHEEL_R] || g != gain_written)
+        write_wheel(WHEEL_R, r, g);
+    gain_written = g;
+    out[WHEEL_L] = l;
+    out[WHEEL_R] = r;
+    return 1;
+}
+
+void drive_tick(int ltarget, int rtarget)
+{
+    if (step(ltarget, rtarget))
+        tlm_motorOut(out[WHEEL_L], out[WHEEL_R]);
+}
+
+void drive_start(void)
+{
+    running = 1;
+}
+
+void drive_target(int ltarget, int rtarget)
+{
+    unsigned char sreg = hal_irq_save();
+
+    target[WHEEL_L] = ltarget;
+    target[WHEEL_R] = rtarget;
+    hal_irq_restore(sreg);
+}
+
+/* Most ticks find both wheels at their targets and leave at the compare */
+void drive_isr(void)
+{
+    if (!running || (out[WHEEL_L] == target[WHEEL_L] && out[WHEEL_R] == target[WHEEL_R] && gain == gain_written))
+        return;
+    if (step(target[WHEEL_L], target[WHEEL_R])) {
+#ifdef TELEMETRY
+        queue_change();
+#endif
+    }
+}
+
+/* M records of the changes drive_isr() made, stamped when it made them */
+void drive_report(void)
+{
+#ifdef TELEMETRY
+    while (chg_tail != chg_head) {
+        unsigned char sreg = hal_irq_save();
+        INT8U  i = chg_tail & (DRIVE_LOG - 1);
+        INT32U ms = changes[i].ms;
+        int    l = changes[i].l, r = changes[i].r;
+
+        chg_tail++;
+        hal_irq_restore(sreg);
+        tlm_motorAt(ms, l, r);
+    }
+#endif
+}
+
+/* Signed PWM straight to one wheel: no limiter, battery gain or calibration */
+void drive_raw(int m, int pwm)
+{
+    if (pwm != 0 && out[m] != 0 && (pwm < 0) != (out[m] < 0)) {
+        motor_set_speed(m, 0);          // the dead time before a reversal
+        OSTimeDly(1);
+    }
+    write_pwm(m, pwm < 0, pwm < 0 ? -pwm : pwm);
+    out[m] = pwm;
+    tlm_motorOut(out[WHEEL_L], out[WHEEL_R]);
+}
+
+/* Interrupts off: a 16-bit OCR1x write must not meet drive_isr() writing the other */
+void drive_stop(void)
+{
+    unsigned char sreg = hal_irq_save();
+
+    out[WHEEL_L] = out[WHEEL_R] = 0;
+    target[WHEEL_L] = target[WHEEL_R] = 0;
+    motor_set_speed(WHEEL_L, 0);
+    motor_set_speed(WHEEL_R, 0);
+    hal_irq_restore(sreg);
+    tlm_motorOut(0, 0);
+}
+
+int drive_left(void)
+{
+    unsigned char sreg = hal_irq_save();
+    int v = out[WHEEL_L];
+
+    hal_irq_restore(sreg);
+    return v;
+}
+
+int drive_right(void)
+{
+    unsigned char sreg = hal_irq_save();
+    int v = out[WHEEL_R];
+
+    hal_irq_restore(sreg);
+    return v;
+}
+
+/* Reads the pack and reports it with the new gain */
+void drive_battery(void)
+{
+    INT16U adc = adcscan_read(DRIVE_ADC_BATT);
+    INT16U mv = read_battery(adc);
+
+    tlm_battery(mv, gain, adc);
+}
+
+void drive_get_cal(struct drive_cal *c)
+{
+    *c = cal;
+}
+
+void drive_set_cal(const struct drive_cal *c)
+{
+    if (c) {
+        cal = *c;
+    } else {
+        cal.dead[WHEEL_L] = cal.dead[WHEEL_R] = 0;
+        cal.gain[WHEEL_L] = cal.gain[WHEEL_R] = DRIVE_GAIN_ONE;
+    }
+    cal.magic = DRIVE_CAL_MAGIC;
+}
+
+/* Stalls ~30 ms; call standing still */
+void drive_save_cal(void)
+{
+    hal_eeprom_write(EE_DRIVECAL, &cal, sizeof(cal));
+}
@@ -0,0 +1,76 @@
+/*
+ *   DRIVE.H -- Slew-limited wheel output for robosample.c
+ *
+ *   The tasks only choose a target speed for each wheel with
+ *   drive_target().  Once drive_start() is called, the Timer2 interrupt
+ *   runs drive_isr() every OS tick, which moves each wheel's output toward
+ *   its target by at most accel when the wheel speeds up and decel when it
+ *   slows down.  A reversal slows to zero first and rests there for one
+ *   tick, so the H-bridge never flips at speed.  Before drive_start(),
+ *   calib.c steps the limiter itself with drive_tick().
+ *
+ *   motor_set_dir() busy-waits 11 ms on a direction change, which no
+ *   interrupt can afford, so the direction pins are written with
+ *   hal_motor_dir() and the tick at rest is the dead time instead.  From
+ *   then on motor_set_dir() and robo_motorSpeed() must not be called: their
+ *   own copy of the direction is stale.  The interrupt cannot format
+ *   telemetry either: it queues each change, and drive_report() sends them
+ *   from task level as M records stamped with the time of the change.
+ *
+ *   Each wheel gets the calibration calib.c stores in EEPROM: its own
+ *   gain, so both wheels turn equally fast for the same speed, and its
+ *   deadband, which a non-zero speed starts from, so a low speed still
+ *   moves the robot.  Without a calibration both are neutral.
+ *
+ *   Last, the PWM, deadband included, is scaled by DRIVE_VBAT_MV over the
+ *   pack voltage, so a speed from robotune.h drives the wheels equally
+ *   fast on a fresh pack and on a sagging one.  drive_battery() reads the
+ *   pack and updates the gain; the pack sags by tens of mV a minute, so a
+ *   few seconds between calls is enough.  The gain is sent over the UART
+ *   as a V record (see telemetry.h).
+ *
+ *   hal_robo.o does not say how the pack reaches ADC5: robo_checkBattery
+ *   only takes a reading below 500 as low.  DRIVE_BATT_FULL_MV is the
+ *   pack voltage at a full-scale reading; 10000 is a 1:2 divider into the
+ *   5 V reference and is not checked against the board.  Calibrate it by
+ *   measuring the pack with a meter while the robot sends V lines:
+ *   DRIVE_BATT_FULL_MV = meter mV * 1023 / the adc count of the V line.
+ */
+
+#ifndef DRIVE_H
+#define DRIVE_H
+
+#include "../inc/kernel.h"
+
+#define DRIVE_ADC_BATT      5           // pack through the board's divider, as robo_checkBattery reads it
+#define DRIVE_BATT_FULL_MV  10000       // pack mV at ADC 1023: 1:2 assumed, calibrate as above
+#define DRIVE_VBAT_MV       7400        // pack voltage robotune.h speeds are meant at
+#define DRIVE_GAIN_ONE      128         // gain 1.0: no correction
+#define DRIVE_GAIN_MIN      102         // 0.8, pack above 9.2 V: reading is off
+#define DRIVE_GAIN_MAX      166         // 1.3, pack below 5.7 V: flat, do not chase it
+
+enum { WHEEL_R, WHEEL_L };              // motor numbers of motor_set_dir/speed
+
+struct drive_cal                        // per wheel, indexed by WHEEL_R/WHEEL_L
+{
+    INT16U magic;
+    INT8U  dead[2];                     // motor_set_speed value the wheel starts to turn at
+    INT8U  gain[2];                     // DRIVE_GAIN_ONE = 1.0
+};
+
+void drive_init(int accel, int decel);  // speed units per tick
+void drive_tick(int ltarget, int rtarget);     // until drive_start() only
+void drive_start(void);                 // from now on drive_isr() applies the targets
+void drive_target(int ltarget, int rtarget);
+void drive_isr(void);                   // Timer2 interrupt, every OS tick
+void drive_report(void);
+void drive_stop(void);                  // at once, bypassing the limiter; targets become 0
+void drive_raw(int m, int pwm);         // for calib.c, before drive_start()
+int  drive_left(void);                  // output now applied
+int  drive_right(void);
+void drive_battery(void);
+void drive_get_cal(struct drive_cal *cal);
+void drive_set_cal(const struct drive_cal *cal);   // neutral if 0; not saved
+void drive_save_cal(void);
+
+#endif
@@ -0,0 +1,362 @@
+/*
+ *   HAL_EXT.C -- Board support that hal_robo.o does not provide
+ *   ATmega328P at 16 MHz; see hal_ext.h
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include "hal_ext.h"
+#include "adcscan.h"
+#include "wdog.h"
+#include "drive.h"
+
+#define TICK_RELOAD     (256 - F_CPU / OS_TICKS_PER_SEC / 1024)     // OSTickISR's
+
+static volatile INT32U ms, tick_at;
+static INT16U stamp;                        // HAL_TICK_UNIT_US at the last compare match
+static struct hal_tick_stats tick;
+static INT16U tick_last;
+static char   tick_on, tick_started;
+#ifdef HAL_TICK_LEGACY
+static unsigned char tick_seen;             // low byte of OSTime
+#else
+static unsigned char tick_ms;               // since the last tick
+#endif
+static volatile char asleep;
+static INT16U sleep_from;
+static INT32U slept, idle_from;             // idle_from in ms
+static INT16U wakes;
+static unsigned char reset_flags __attribute__((section(".noinit")));
+static unsigned char wdt_who[2] __attribute__((section(".noinit")));    // who, ~who
+static volatile char adc_scan, adc_busy;
+static unsigned char adc_ch;                // converting now
+
+static char txbuf[HAL_UART_TXBUF];
+static volatile unsigned char txhead, txtail;
+
+/*
+ *   Runs before main(): the watchdog stays on after it resets the board,
+ *   at its shortest timeout, and would go on resetting it.
+ */
+static void reset_init(void) __attribute__((naked, used, section(".init3")));
+static void reset_init(void)
+{
+    reset_flags = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+void hal_wdt_start(void)
+{
+    wdt_who[0] = wdt_who[1] = 0;            // no culprit until a trip names one
+    wdt_enable(WDTO_250MS);
+}
+
+void hal_wdt_kick(void)
+{
+    wdt_reset();
+}
+
+void hal_wdt_trip(INT8U who)
+{
+    cli();
+    wdt_who[0] = who;
+    wdt_who[1] = ~who;
+    wdt_enable(WDTO_15MS);
+    for (;;)
+        ;
+}
+
+INT8U hal_wdt_culprit(void)
+{
+    if (!(reset_flags & _BV(WDRF)))
+        return HAL_WDT_NONE;
+    if ((INT8U)~wdt_who[0] != wdt_who[1])
+        return HAL_WDT_UNKNOWN;
+    return wdt_who[0];
+}
+
+void hal_clock_init(void)
+{
+    TCCR2A = _BV(WGM21);                    // CTC on OCR2A
+    OCR2A  = F_CPU / 64 / 1000 - 1;         // 250 counts at clk/64 = 1 ms
+    TCNT2  = 0;
+    TCCR2B = _BV(CS22);                     // clk/64
+    TIMSK2 = _BV(OCIE2A);
+}
+
+void hal_tick_init(void)
+{
+    unsigned char sreg = SREG;
+
+    cli();
+    tick.min = 0xffff;
+    tick_started = 0;
+#ifdef HAL_TICK_LEGACY
+    tick_seen = OSTime;
+#else
+    TCCR0B = 0;                             // stopped; TOIE0 stays on for OSTickISR
+    TCNT0  = 0;
+    TIFR0  = _BV(TOV0);
+    tick_ms = 0;
+#endif
+    tick_on = 1;
+    SREG = sreg;
+}
+
+static void tick_record(INT16U t)
+{
+    INT16U d = t - tick_last;
+
+    tick_last = t;
+    if (!tick_started) {
+        tick_started = 1;
+        return;
+    }
+    if (d < tick.min)
+        tick.min = d;
+    if (d > tick.max)
+        tick.max = d;
+    tick.sum += d;
+    tick.n++;
+}
+
+void hal_tick_stats(struct hal_tick_stats *s)
+{
+    unsigned char sreg = SREG;
+
+    cli();
+    *s = tick;
+    tick.min = 0xffff;
+    tick.max = 0;
+    tick.sum = 0;
+    tick.n = 0;
+    SREG = sreg;
+}
+
+/* HAL_TICK_UNIT_US; interrupts off */
+static INT16U now_units(void)
+{
+    INT16U s = stamp;
+    unsigned char c = TCNT2;
+
+    if (TIFR2 & _BV(OCF2A)) {               // wrapped; the Timer2 interrupt is pending
+        s += F_CPU / 64 / 1000;
+        c = TCNT2;
+    }
+    return s + c;
+}
+
+static void woke(INT16U now)
+{
+    asleep = 0;
+    slept += (INT16U)(now - sleep_from);
+    wakes++;
+}
+
+void hal_idle_sleep(void)
+{
+    cli();
+    sleep_from = now_units();
+    asleep = 1;
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sei();                                  // the sleep is executed before any pending interrupt
+    sleep_cpu();
+    sleep_disable();
+}
+
+void hal_idle_stats(struct hal_idle_stats *s)
+{
+    unsigned char sreg = SREG;
+    INT32U t;
+
+    cli();
+    t = ms;
+    s->slept = slept;
+    s->wakes = wakes;
+    s->span  = (t - idle_from) * (1000 / HAL_TICK_UNIT_US);
+    slept = 0;
+    wakes = 0;
+    idle_from = t;
+    SREG = sreg;
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+    INT16U now = stamp + TCNT2;             // TCNT2 counts the latency of this entry
+
+    if (asleep)
+        woke(now);
+    stamp += F_CPU / 64 / 1000;
+    wdog_isr();
+    if (tick_on) {
+#ifdef HAL_TICK_LEGACY
+        if ((unsigned char)OSTime != tick_seen) {   // ticked within the last ms, TCNT0 counts since
+            tick_seen = OSTime;
+            tick_at = ms;                   // within a ms
+            tick_record(now - (INT16U)(TCNT0 - TICK_RELOAD) * (1024 / 64));
+            drive_isr();
+        }
+#else
+        if (++tick_ms == HAL_TICK_MS) {
+            tick_ms = 0;
+            tick_at = ms + 1;
+            tick_record(now);
+            TCNT0  = 0xff;                  // one clock from overflow: OSTickISR is
+            TCCR0B = _BV(CS00);             // pending when this returns
+            __asm__ __volatile__("nop");
+            TCCR0B = 0;
+            drive_isr();
+        }
+#endif
+    }
+    ms++;
+    if (adc_scan && !adc_busy) {            // a round of channels 0-5 every ms
+        adc_busy = 1;
+        adc_ch = 0;
+        ADMUX = _BV(REFS0);
+        ADCSRA |= _BV(ADSC);
+    }
+}
+
+INT32U hal_millis(void)
+{
+    INT32U t;
+    unsigned char sreg = SREG;
+
+    cli();
+    t = ms;
+    SREG = sreg;
+    return t;
+}
+
+INT32U hal_tick_millis(void)
+{
+    INT32U t;
+    unsigned char sreg = SREG;
+
+    cli();
+    t = tick_at;
+    SREG = sreg;
+    return t;
+}
+
+/* The pins motor_set_dir() in hal_robo.o drives: right PD6/PD7, left PD4/PD5 */
+void hal_motor_dir(INT8U m, char rev)
+{
+    unsigned char sreg = SREG, pd;
+
+    cli();
+    pd = PORTD;
+    if (m == 0)
+        pd = (pd & ~(_BV(PD6) | _BV(PD7))) | (rev ? _BV(PD6) : _BV(PD7));
+    else
+        pd = (pd & ~(_BV(PD4) | _BV(PD5))) | (rev ? _BV(PD5) : _BV(PD4));
+    PORTD = pd;
+    SREG = sreg;
+}
+
+unsigned char hal_irq_save(void)
+{
+    unsigned char sreg = SREG;
+
+    cli();
+    return sreg;
+}
+
+void hal_irq_restore(unsigned char sreg)
+{
+    SREG = sreg;
+}
+
+/* Rounds start from the Timer2 clock, so only after hal_clock_init() */
+void hal_adc_scan_start(void)
+{
+    ADCSRA = _BV(ADEN) | _BV(ADIE)
+           | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);   // clk/128: 125 kHz, 104 us a conversion
+    adc_busy = 0;
+    adc_scan = 1;
+}
+
+ISR(ADC_vect)
+{
+    unsigned char ch = adc_ch;
+
+    if (asleep)
+        woke(now_units());
+    adcscan_isr(ch, ADC);
+    if (++ch < ADC_NCH) {
+        ADMUX = _BV(REFS0) | ch;            // AVcc, as ADC_read
+        ADCSRA |= _BV(ADSC);
+        adc_ch = ch;
+    } else {
+        adc_busy = 0;
+    }
+}
+
+void hal_uart_init(unsigned int ubrr)
+{
+    while (!(UCSR0A & _BV(UDRE0)))          // let a pending cputchar finish
+        ;
+    UBRR0H = ubrr >> 8;
+    UBRR0L = ubrr;
+    UCSR0A = 0;
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0);
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);     // 8N1
+    txhead = txtail = 0;
+}
+
+/* Queues all of buf or, if it does not fit, none of it; returns 1 if queued */
+char hal_uart_write(const char *buf, unsigned char len)
+{
+    unsigned char sreg = SREG, head;
+
+    cli();
+    if ((unsigned char)(HAL_UART_TXBUF - 1 - ((txhead - txtail) & (HAL_UART_TXBUF - 1))) < len) {
+        SREG = sreg;
+        return 0;
+    }
+    head = txhead;
+    while (len--) {
+        txbuf[head] = *buf++;
+        head = (head + 1) & (HAL_UART_TXBUF - 1);
+    }
+    txhead = head;
+    UCSR0B |= _BV(UDRIE0);
+    SREG = sreg;
+    return 1;
+}
+
+int hal_uart_read(void)
+{
+    if (!(UCSR0A & _BV(RXC0)))
+        return -1;
+    return UDR0;
+}
+
+ISR(USART_UDRE_vect)
+{
+    if (asleep)
+        woke(now_units());
+    if (txtail == txhead) {
+        UCSR0B &= ~_BV(UDRIE0);
+        return;
+    }
+    UDR0 = txbuf[txtail];
+    txtail = (txtail + 1) & (HAL_UART_TXBUF - 1);
+}
+
+void hal_eeprom_read(INT16U addr, void *buf, INT16U len)
+{
+    eeprom_read_block(buf, (const void *)addr, len);
+}
+
+/* Only bytes that differ are written, which saves time and wear */
+void hal_eeprom_write(INT16U addr, const void *buf, INT16U len)
+{
+    eeprom_update_block(buf, (void *)addr, len);
+}
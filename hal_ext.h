@@ -0,0 +1,97 @@
+/*
+ *   HAL_EXT.H -- Board support that hal_robo.o does not provide
+ *
+ *   Timer2 runs a free 1 ms clock (Timer1 is the motor PWM) and paces the
+ *   OS tick, the ADC can scan its channels in the background for
+ *   adcscan.c, and the UART gets an interrupt-driven transmit buffer, so
+ *   logging does not busy-wait like cputchar.
+ */
+
+#ifndef HAL_EXT_H
+#define HAL_EXT_H
+
+#include "../inc/kernel.h"
+
+#define HAL_UART_TXBUF      128         // transmit buffer, power of two
+#define HAL_UBRR_38400      25          // 38462 baud at 16 MHz, 0.2% error
+#define HAL_TICK_MS         (1000 / OS_TICKS_PER_SEC)
+#define HAL_TICK_UNIT_US    4           // a Timer2 count at clk/64
+#define HAL_MCU_ACTIVE_UA   9500
+#define HAL_MCU_IDLE_UA     2600
+#define HAL_WDT_TIMEOUT_MS  250
+#define HAL_WDT_NONE        0xff        // hal_wdt_culprit(): not a watchdog reset
+#define HAL_WDT_UNKNOWN     0xfe        // a watchdog reset no hal_wdt_trip() asked for
+
+/* EEPROM layout (1 KB on the ATmega328P) */
+#define HAL_EEPROM_SIZE     1024
+#define EE_TRACKMAP         0x000       // trackmap.c, 256 bytes
+#define EE_DRIVECAL         0x100       // drive.c wheel calibration, 6 bytes
+#define EE_LINECAL          0x108       // linesens.c extremes, 14 bytes
+#define EE_WDOG             0x118       // wdog.c reset log, 4 bytes
+
+/* The free 1 ms Timer2 clock */
+void   hal_clock_init(void);
+INT32U hal_millis(void);
+
+struct hal_tick_stats
+{
+    INT16U min, max;                    // HAL_TICK_UNIT_US
+    INT32U sum;
+    INT16U n;                           // intervals
+};
+
+/* OS_ticks_init() leaves the OS tick to Timer0 overflowing from a reload
+   of 100, which OSTickISR writes only once it has saved the registers, so
+   every count that passes with interrupts off makes that tick 64 us
+   longer.  hal_tick_init() stops Timer0 and has the Timer2 interrupt
+   clock it once to overflow every HAL_TICK_MS, so OSTickISR follows on a
+   period the hardware keeps.  Each tick the Timer2 interrupt also runs
+   drive_isr().  hal_tick_stats() gives the intervals that interrupt saw;
+   build with -DHAL_TICK_LEGACY to measure the Timer0 tick instead */
+void   hal_tick_init(void);             // after OS_ticks_init() and hal_clock_init()
+void   hal_tick_stats(struct hal_tick_stats *s);   // since the last call
+INT32U hal_tick_millis(void);           // hal_millis() at the last OS tick
+
+struct hal_idle_stats
+{
+    INT32U slept, span;                 // HAL_TICK_UNIT_US
+    INT16U wakes;
+};
+
+/* SLEEP_MODE_IDLE until the next interrupt, the 1 ms Timer2 one at the
+   latest; the timers, ADC and UART run on.  ADC noise-reduction sleep
+   would stop Timer2, so it is not used.  From the time asleep,
+   HAL_MCU_ACTIVE_UA and HAL_MCU_IDLE_UA (datasheet typicals at 5 V,
+   16 MHz) estimate the current of the MCU alone */
+void   hal_idle_sleep(void);            // until the next interrupt; from the lowest task only
+void   hal_idle_stats(struct hal_idle_stats *s);   // since the last call
+
+/* The hardware watchdog is off until hal_wdt_start(); then hal_wdt_kick()
+   must follow within HAL_WDT_TIMEOUT_MS.  The reset flags are read, and
+   the watchdog turned off again, before main() */
+void   hal_wdt_start(void);
+void   hal_wdt_kick(void);
+void   hal_wdt_trip(INT8U who);         // resets at once; who survives for hal_wdt_culprit()
+INT8U  hal_wdt_culprit(void);
+
+/* The H-bridge direction pins as motor_set_dir() sets them, without its
+   busy-waits, so an interrupt may call it; the wheel's PWM must be zero */
+void   hal_motor_dir(INT8U m, char rev);  // m as motor_set_dir(): 0 right, 1 left
+
+unsigned char hal_irq_save(void);       // SREG, then interrupts off
+void   hal_irq_restore(unsigned char sreg);
+
+void   hal_adc_scan_start(void);        // every conversion goes to adcscan_isr()
+
+/* Interrupt-driven UART; do not mix with cputchar/cprintf, the two would
+   interleave byte by byte */
+void   hal_uart_init(unsigned int ubrr);
+char   hal_uart_write(const char *buf, unsigned char len);
+int    hal_uart_read(void);             // a received byte, or -1
+
+/* A write busy-waits about 3.4 ms per changed byte; only where the robot
+   can afford to stall (standing still) */
+void   hal_eeprom_read(INT16U addr, void *buf, INT16U len);
+void   hal_eeprom_write(INT16U addr, const void *buf, INT16U len);
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ *   JOBS.C -- Time-triggered jobs run to completion; see jobs.h
+ */
+
+#include "jobs.h"
+#include "hal_ext.h"
+
+struct job
+{
+    void   (*fn)(void);
+    INT16U period;
+    INT32U next;                        // hal_millis() of the next release
+};
+
+static struct job jobs[JOBS_MAX];
+static INT8U njobs;
+
+void jobs_add(void (*fn)(void), INT16U period_ms, INT16U offset_ms)
+{
+    struct job *j;
+
+    if (njobs == JOBS_MAX)
+        return;
+    j = &jobs[njobs++];
+    j->fn = fn;
+    j->period = period_ms;
+    j->next = hal_millis() + offset_ms;
+}
+
+void jobs_run(void)
+{
+    INT32U now = hal_millis();
+    INT8U i;
+
+    for (i = 0; i < njobs; i++) {
+        struct job *j = &jobs[i];
+
+        if ((INT32S)(now - j->next) < 0)
+            continue;
+        j->next += j->period;
+        if ((INT32S)(now - j->next) >= 0)
+            j->next = now + j->period;  // held off past a release: drop the missed ones
+        j->fn();
+    }
+}
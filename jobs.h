@@ -0,0 +1,28 @@
+/*
+ *   JOBS.H -- Time-triggered jobs run to completion in one task
+ *
+ *   Small periodic chores (the heartbeat LED, the battery check, the
+ *   telemetry flush, the status reports) do not each need a uC/OS task, a
+ *   TCB and a stack.  They are jobs instead: plain functions that do their
+ *   work and return, which jobs_run() calls from a single task when they
+ *   are due.  A job is released every period ms from its offset, so jobs
+ *   of the same period can be spread apart.  Jobs share the stack of the
+ *   task calling jobs_run(), and one job runs at a time, so a job must
+ *   not block: no OSTimeDly(), no waiting for a button.
+ *
+ *   The task calling jobs_run() may be held off for longer than a period
+ *   (a honk busy-waits 600 ms); a job that is late then runs once and its
+ *   missed releases are dropped, not run back to back.
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "../inc/kernel.h"
+
+#define JOBS_MAX            6
+
+void jobs_add(void (*fn)(void), INT16U period_ms, INT16U offset_ms);   // offset from now
+void jobs_run(void);                    // the due jobs, in the order added
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ *   LIGHTSENS.H -- Light sensor level, ambient baseline and lamp edges
+ *
+ *   Replaces robo_lightSensor() and its fixed "> LIGHT_THRESHOLD" test,
+ *   which misses a lamp in a dark room and sees one everywhere in a
+ *   bright one.  lightsens_update() takes one light ADC read, turns it
+ *   into robo_lightSensor()'s 0-100 level through a 256-entry PROGMEM
+ *   table instead of a 16-bit division, and compares it with an ambient
+ *   baseline:
+ *
+ *   - away from a lamp the baseline follows a falling level within a few
+ *     reads and a rising one with a time constant of LIGHT_RISE_SHIFT reads;
+ *   - nearer a lamp than the off threshold it only creeps up, about 1/256
+ *     of the gap a read, so a room light switched on still clears.
+ *
+ *   A lamp is seen when the level is at least the on threshold above the
+ *   baseline, and no longer when it has fallen below the off threshold;
+ *   lightsens_update() returns the edge, if any.
+ */
+
+#ifndef LIGHTSENS_H
+#define LIGHTSENS_H
+
+#include "../inc/kernel.h"
+
+#define LIGHT_ADC           4           // as robo_lightSensor
+#define LIGHT_BASE_SHIFT    8           // baseline kept in 1/256 level
+#define LIGHT_FALL_SHIFT    2           // baseline relaxes by 1/4 of the gap per read when darker,
+#define LIGHT_RISE_SHIFT    6           // 1/64 when brighter,
+#define LIGHT_CREEP_SHIFT   8           // and 1/256 near a lamp
+
+enum { LIGHT_NONE, LIGHT_RISE, LIGHT_FALL };
+
+char lightsens_update(INT16U adc, INT8U on, INT8U off);     // LIGHT_RISE/LIGHT_FALL on an edge
+
+#endif
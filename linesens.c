@@ -0,0 +1,120 @@
+/*
+ *   LINESENS.C -- Line sensors with adaptive thresholds; see linesens.h
+ */
+
+#include "linesens.h"
+#include "hal_ext.h"
+#include "adcscan.h"
+
+#define LS_MAGIC        0x4c53          // "LS"; bump when struct ls_cal changes
+#define LS_SHIFT        6               // extremes are kept in 1/64 ADC counts
+
+struct ls_cal
+{
+    INT16U magic;
+    INT16U lo[LS_NCH], hi[LS_NCH];      // darkest and brightest, << LS_SHIFT
+};
+
+static struct ls_cal cal;
+static INT16U last[LS_NCH];
+
+static void track(INT8U ch, INT16U v)
+{
+    INT16U v6 = v << LS_SHIFT;
+
+    if (v6 < cal.lo[ch])
+        cal.lo[ch] = v6;
+    else
+        cal.lo[ch] += ((INT32S)v6 - cal.lo[ch]) >> LS_RELAX_SHIFT;
+    if (v6 > cal.hi[ch])
+        cal.hi[ch] = v6;
+    else
+        cal.hi[ch] -= ((INT32S)cal.hi[ch] - v6) >> LS_RELAX_SHIFT;
+}
+
+static char has_contrast(INT8U ch)
+{
+    return cal.hi[ch] > cal.lo[ch] && cal.hi[ch] - cal.lo[ch] >= (LS_MIN_CONTRAST << LS_SHIFT);
+}
+
+INT16U linesens_threshold(INT8U ch)
+{
+    if (!has_contrast(ch))
+        return LS_DEFAULT_THRESHOLD;
+    return (cal.lo[ch] + (INT32U)(cal.hi[ch] - cal.lo[ch]) * LS_THRESHOLD_PCT / 100) >> LS_SHIFT;
+}
+
+int linesens_code(void)
+{
+    int code = 0;
+    INT8U ch;
+
+    for (ch = 0; ch < LS_NCH; ch++) {
+        last[ch] = adcscan_read(LS_ADC_FIRST + ch);
+        track(ch, last[ch]);
+    }
+    for (ch = 0; ch < LS_NCH; ch++) {
+        code <<= 1;
+        if (last[ch] < linesens_threshold(ch))
+            code |= 1;
+    }
+    return code;
+}
+
+INT16U linesens_read(INT8U ch)
+{
+    return last[ch];
+}
+
+INT8U linesens_norm(INT8U ch)
+{
+    INT16U lo = cal.lo[ch] >> LS_SHIFT, hi = cal.hi[ch] >> LS_SHIFT;
+
+    if (!has_contrast(ch))
+        return last[ch] < LS_DEFAULT_THRESHOLD ? 100 : 0;
+    if (last[ch] <= lo)
+        return 100;
+    if (last[ch] >= hi)
+        return 0;
+    return (INT32U)(hi - last[ch]) * 100 / (hi - lo);
+}
+
+/* Line position from the last read; 0 if no channel sees a line */
+char linesens_centroid(int *pos)
+{
+    int l = linesens_norm(LS_LEFT), m = linesens_norm(LS_MIDDLE), r = linesens_norm(LS_RIGHT);
+
+    if (l + m + r < 50)
+        return 0;
+    *pos = (r - l) * 100 / (l + m + r);
+    return 1;
+}
+
+void linesens_forget(void)
+{
+    INT8U ch;
+
+    for (ch = 0; ch < LS_NCH; ch++) {
+        cal.lo[ch] = 1023U << LS_SHIFT;
+        cal.hi[ch] = 0;
+    }
+    cal.magic = LS_MAGIC;
+}
+
+void linesens_init(void)
+{
+    hal_eeprom_read(EE_LINECAL, &cal, sizeof(cal));
+    if (cal.magic != LS_MAGIC)
+        linesens_forget();
+}
+
+char linesens_valid(void)
+{
+    return has_contrast(LS_LEFT) && has_contrast(LS_MIDDLE) && has_contrast(LS_RIGHT);
+}
+
+/* Stalls ~45 ms; call standing still */
+void linesens_save(void)
+{
+    hal_eeprom_write(EE_LINECAL, &cal, sizeof(cal));
+}
@@ -0,0 +1,49 @@
+/*
+ *   LINESENS.H -- Line sensors with per-channel adaptive thresholds
+ *
+ *   Replaces robo_lineSensor(), whose fixed threshold of 300 ADC counts
+ *   fails on a light line or a dark floor.  Every read samples the three
+ *   reflectance channels and tracks the darkest and brightest value each
+ *   one has seen: a new extreme is taken at once, and both extremes relax
+ *   toward the current reading with a time constant of about 40 s at one
+ *   read per tick, so the robot follows a change of floor or lighting.
+ *   A channel's threshold lies LS_THRESHOLD_PCT of the way from its line
+ *   extreme to its floor extreme, where the fixed 300 sits on the usual
+ *   floor; until it has seen at least LS_MIN_CONTRAST between them it uses
+ *   LS_DEFAULT_THRESHOLD.
+ *
+ *   The same extremes normalise each channel: linesens_norm() puts the
+ *   last read on 0 (floor) to 100 (line), so channels of different gain
+ *   weigh alike in linesens_centroid(), the line position Navig steers by
+ *   while the middle sensor is on the line.
+ *
+ *   calib.c sweeps the sensors over the line at calibration time and
+ *   stores the extremes in EEPROM as the starting point of every run.
+ */
+
+#ifndef LINESENS_H
+#define LINESENS_H
+
+#include "../inc/kernel.h"
+
+#define LS_NCH                  3
+#define LS_ADC_FIRST            1       // left, middle, right: ADC 1-3, as robo_lineSensor
+#define LS_DEFAULT_THRESHOLD    300     // robo_lineSensor's; the line reads lower
+#define LS_MIN_CONTRAST         150     // ADC counts between the extremes
+#define LS_THRESHOLD_PCT        31      // of the way from line to floor; where 300 sits on the usual floor
+#define LS_RELAX_SHIFT          12      // extremes relax by 1/4096 of the gap per read
+
+enum { LS_LEFT, LS_MIDDLE, LS_RIGHT };
+
+int   linesens_code(void);              // same bits as robo_lineSensor: left 4, middle 2, right 1
+INT16U linesens_read(INT8U ch);         // ADC counts linesens_code() read last
+INT8U linesens_norm(INT8U ch);          // last read, 0 = floor .. 100 = line
+char  linesens_centroid(int *pos);      // -100 under the left .. +100 under the right
+INT16U linesens_threshold(INT8U ch);
+
+void  linesens_init(void);              // extremes from EEPROM, if calibrated
+void  linesens_forget(void);
+char  linesens_valid(void);             // every channel has its own threshold
+void  linesens_save(void);
+
+#endif
@@ -3,36 +3,94 @@
  *   Written by:  Rosbi Mamat  6/5/2014
  *   Updated  :  6/5/2025  Enhanced navigation with continuous recovery, LED blink at A, and refined logic
  *   Updated  :  6/12/2025  Modified to handle track layout with checkpoints A-F and light sensors L1-L2
+ *   Updated  :  10/17/2026 Speed/threshold constants moved to robotune.h for the sim/ optimizer
+ *   Updated  :  10/17/2026 Sensor/motor telemetry for replay (build with -DTELEMETRY)
+ *   Updated  :  10/17/2026 Track learning: lap 1 maps the course, later runs take straights at HIGH_SPEED
+ *   Updated  :  10/17/2026 Per-checkpoint speed/turn/recovery/light profiles in a PROGMEM table
+ *   Updated  :  10/17/2026 Full bars detected on the fly, debounced, without stopping
+ *   Updated  :  10/17/2026 Checkpoint bars need hysteresis, spacing and a confidence score (checkpoint.c)
+ *   Updated  :  10/17/2026 Lost-line search planned in elapsed time and estimated heading, not loop counts
+ *   Updated  :  10/17/2026 Tasks set wheel targets only; CntrlMotors slews the outputs every tick (drive.c)
+ *   Updated  :  10/17/2026 Wheel PWM scaled by pack voltage, read every 5 s by TaskStart
+ *   Updated  :  10/17/2026 Hold go at power-on to calibrate wheel deadband and gain (calib.c)
+ *   Updated  :  10/17/2026 Line sensors read with adaptive per-channel thresholds (linesens.c)
+ *   Updated  :  10/17/2026 Lamps seen as edges above a tracked ambient baseline, with hysteresis (lightsens.c)
+ *   Updated  :  10/17/2026 Sensors oversampled and filtered in the ADC ISR (adcscan.c)
+ *   Updated  :  10/17/2026 Delays converted to ticks at compile time (delay.h), not by OSTimeDlyHMSM
+ *   Updated  :  10/17/2026 OS tick paced by the Timer2 clock, not Timer0 reloads; tick jitter reported
+ *   Updated  :  10/17/2026 CPU sleeps when no task is ready (TaskSleep); MCU current and wakes reported
+ *   Updated  :  10/17/2026 Hardware watchdog kicked only while every task checks in (wdog.c)
+ *   Updated  :  10/17/2026 Response times and deadline misses per task, sent on request (rtmon.c)
+ *   Updated  :  10/17/2026 Tasks, stacks and their supervision from one table; stack high-water marks
+ *   Updated  :  10/17/2026 Wheel outputs slewed in the Timer2 interrupt (drive_isr); CntrlMotors removed
+ *   Updated  :  10/17/2026 Periodic chores are jobs (jobs.c) of TaskStart, now the lowest task; TaskSleep merged in
  */
 
-#include "..\inc\kernel.h"
-#include "..\inc\hal_robo.h"
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "../inc/kernel.h"
+#include "../inc/hal_robo.h"
+#include "robotune.h"
+#include "telemetry.h"
+#include "hal_ext.h"
+#include "trackmap.h"
+#include "checkpoint.h"
+#include "drive.h"
+#include "calib.h"
+#include "linesens.h"
+#include "lightsens.h"
+#include "adcscan.h"
+#include "delay.h"
+#include "wdog.h"
+#include "rtmon.h"
+#include "tasks.h"
+#include "jobs.h"
 
-#define STOP_SPEED     0
-#define VERY_LOW_SPEED 20
-#define LOW_SPEED     30
-#define MEDIUM_SPEED  45
-#define HIGH_SPEED    55
-#define REVERSE_SPEED -25
+// TaskStart's jobs (jobs.c): period and offset in ms, the offsets spreading
+// the 5 s ones apart
+#define JOB_POLL_MS            100  // UART requests
+#define JOB_FLUSH_MS   HAL_TICK_MS  // M lines queued by the Timer2 interrupt
+#define JOB_HEARTBEAT_MS      5000
+#define JOB_BATTERY_MS        5000
+#define JOB_BATTERY_OFFSET    1700
+#define JOB_REPORT_MS         5000
+#define JOB_REPORT_OFFSET     3300
 
-#define TASK_STK_SZ            128
-#define TASK_START_PRIO          1
-#define TASK_CHKCOLLIDE_PRIO     2
-#define TASK_CTRLMOTOR_PRIO      3
-#define TASK_NAVIG_PRIO          4
+// linesens_centroid() of a line seen equally by the middle and one outer
+// sensor, where Navig turns at TURN_GENTLE_PCT
+#define CENTROID_GENTLE         50
 
-OS_STK TaskStartStk[TASK_STK_SZ];
-OS_STK ChkCollideStk[TASK_STK_SZ];
-OS_STK CtrlmotorStk[TASK_STK_SZ];
-OS_STK NavigStk[TASK_STK_SZ];
+// Lost-line search.  Heading is estimated as (lspeed - rspeed) x ms >> 7;
+// pivoting at LOW_SPEED that is about SEARCH_DEG90 for a quarter turn.
+#define SEARCH_BACKUP_MS       300  // back up first when the line went off to one side
+#define SEARCH_GAP_MS          400  // straight on first when it vanished under the middle
+#define SEARCH_DEG90           260
+#define SEARCH_MAX_MS         6000  // then drive on a little and start over
+#define L2_TURN_MIN             30  // L2 maneuver: heading turned, ~10 deg, before a line ends the turn
+
+#define STK_FILL            0xa5        // untouched stack bytes, for the high-water marks
+
+struct task_desc
+{
+    void   (*fn)(void *data);
+    OS_STK *stk;
+    INT16U stk_size;
+    INT8U  prio;
+    INT16U wdog_ms, period_ms;
+};
+
+#define TASK_PROTO(fn, prio, stk, wdog, period)     void fn(void *data);
+#define TASK_STACK(fn, prio, stk, wdog, period)     OS_STK fn##Stk[stk];
+TASKS(TASK_PROTO)
+TASKS(TASK_STACK)
 
 struct robostate
 {
-    int rspeed;
+    int rspeed;                 // wheel targets; steer() hands them to drive.c
     int lspeed;
     char obstacle;
+    int obstacle_speed;         // both wheels while obstacle is set (CheckCollision)
     int score;
-    int lightDetected;
 } myrobot;
 
 typedef enum { CP_START, CP_A, CP_B, CP_C, CP_D, CP_E, CP_F, CP_DONE } CpState;
@@ -40,9 +98,49 @@ static CpState  cp_state = CP_START;
 static char     seenL1   = 0;
 static char     seenL2   = 0;
 static char     performedL2Task = 0;
-static int      lightThreshold = 70;
+static char     calibrate = 0;          // go held at power-on
+static INT8U    wdog_culprit = WDOG_NONE;   // of the watchdog reset we powered up from
+
+typedef enum { SEARCH_OFF, SEARCH_BACKUP, SEARCH_AHEAD, SEARCH_SWEEP } SearchPhase;
+static SearchPhase search = SEARCH_OFF;
+
+typedef enum { LIGHT_L1, LIGHT_L2, LIGHT_L2_TASK } LightPolicy;
+
+// How to drive each section of the course, indexed by cp_state.  Speeds and
+// turn ratios are relative to robotune.h so the optimizer still applies.
+// The sections with tight bends (B: S-bends of radius 35, D: the spur and a
+// radius 30 arc) turn harder; F's long straight cruises faster.
+typedef struct
+{
+    unsigned char cruise_pct;   // % of MEDIUM_SPEED when following the line
+    signed char   gentle_adj;   // added to TURN_GENTLE_PCT on codes 3/6
+    signed char   sharp_adj;    // added to TURN_SHARP_PCT on codes 1/4
+    unsigned char light;        // LightPolicy: which lamp a bright reading is
+} CpProfile;
+
+static const CpProfile cp_profile[] PROGMEM = {
+    /* CP_START */ { 100,  0,   0, LIGHT_L1 },
+    /* CP_A     */ { 100,  0,   0, LIGHT_L1 },
+    /* CP_B     */ { 100, -5, -10, LIGHT_L1 },
+    /* CP_C     */ { 100,  0,   0, LIGHT_L2 },
+    /* CP_D     */ { 100, -5, -15, LIGHT_L2_TASK },     // L2 spur
+    /* CP_E     */ { 100,  0,   0, LIGHT_L2 },
+    /* CP_F     */ { 115,  0,   0, LIGHT_L2 },
+    /* CP_DONE  */ { 100,  0,   0, LIGHT_L2 },
+};
 
-void blinkLED(char times, int interval_ms);
+void blinkLED(char times, INT16U interval_ticks);
+
+// Hands the wheel targets to drive.c, whose interrupt ramps the outputs to
+// them; CheckCollision's target overrides Navig's while an obstacle is
+// being handled.  Call after changing any of them.
+static void steer(void)
+{
+    if (myrobot.obstacle)
+        drive_target(myrobot.obstacle_speed, myrobot.obstacle_speed);
+    else
+        drive_target(myrobot.lspeed, myrobot.rspeed);
+}
 
 void CheckCollision(void *data)
 {
@@ -50,17 +148,24 @@ void CheckCollision(void *data)
     
     for (;;)
     {
-        char current_obstacle = (robo_proxSensor() == 1);
+        char current_obstacle;
+
+        wdog_checkin(TASK_CHKCOLLIDE_PRIO);
+        current_obstacle = (tlm_proxSensor() == 1);
         
         // Detect new obstacle
         if (current_obstacle) {
             // Obstacle detected - stop and honk
+            char is_new = !myrobot.obstacle;
             myrobot.obstacle = 1;
             obstacle_timer = 0;
             
-            // Stop immediately and honk to signal obstacle detection
-            robo_motorSpeed(STOP_SPEED, STOP_SPEED);
-            robo_Honk();
+            // Stop immediately and honk once to signal obstacle detection;
+            // honking every cycle, its 600 ms busy-wait would be late to see it go
+            myrobot.obstacle_speed = STOP_SPEED;
+            drive_stop();
+            if (is_new)
+                robo_Honk();
         }
         // Handle obstacle recovery - similar to case 0 (lost line)
         else if (myrobot.obstacle) {
@@ -69,13 +174,13 @@ void CheckCollision(void *data)
             
             if (obstacle_timer < 5) {
                 // First wait a moment to ensure obstacle is gone
-                robo_motorSpeed(STOP_SPEED, STOP_SPEED);
+                myrobot.obstacle_speed = STOP_SPEED;
             } else {
                 // Move forward slowly to find line
-                robo_motorSpeed(VERY_LOW_SPEED, VERY_LOW_SPEED);
+                myrobot.obstacle_speed = VERY_LOW_SPEED;
                 
                 // If line found or timeout, end recovery
-                if (robo_lineSensor() != 0 || obstacle_timer > 40) {
+                if (tlm_lineSensor() != 0 || obstacle_timer > 40) {
                     myrobot.obstacle = 0;
                     obstacle_timer = 0;
                 }
@@ -84,116 +189,178 @@ void CheckCollision(void *data)
             // No obstacle
             myrobot.obstacle = 0;
         }
+        steer();
         
-        OSTimeDlyHMSM(0, 0, 0, 100);
+        rtmon_done(TASK_CHKCOLLIDE_PRIO);
+        rtmon_dly(TASK_CHKCOLLIDE_PRIO, MS_TO_TICKS(CHKCOLLIDE_PERIOD_MS));
     }
 }
 
-void CntrlMotors(void *data)
+// Delay that samples the line every tick so a bar is not missed between Navig
+// cycles; during a lost-line search it ends as soon as the line is back.  Its
+// last sample is the one the next Navig cycle starts with, so Navig does not
+// hand that reading to checkpoint_sample() again.
+void barWait(INT16U ticks)
 {
-    int speed_r, speed_l;
-    for (;;)
+    for (; ticks > 0; ticks--)
+    {
+        int code;
+        rtmon_dly(TASK_NAVIG_PRIO, 1);      // the next Navig job starts at the last of these
+        code = tlm_lineSensor();
+        checkpoint_sample(code);
+        if (search != SEARCH_OFF && code != 0)
+            break;
+    }
+}
+
+// Turns for up to ticks, reading the line every tick; ends once the
+// estimated heading has turned by min and the sensors are on a line.  The
+// heading is integrated from the applied outputs, as in lostSearch(), so
+// the slew limiter's ramps do not change how far the robot turns.
+void turnToLine(INT16U ticks, int min)
+{
+    long   heading = 0;
+    INT32U t_last = hal_millis();
+
+    for (; ticks > 0; ticks--)
+    {
+        INT32U now;
+        int    code;
+
+        OSTimeDly(1);
+        now = hal_millis();
+        heading += (long)(drive_left() - drive_right()) * (long)(now - t_last) >> 7;
+        t_last = now;
+        code = tlm_lineSensor();
+        if ((heading < 0 ? -heading : heading) >= min && code != 0)
+            break;
+    }
+}
+
+// Lost-line search, one step per Navig cycle while code is 0.  Pivots toward
+// the side the line was last seen on, then back the other way through a
+// growing arc: each leg ends one quarter turn further out on estimated
+// heading, so a line behind the robot is found too.
+void lostSearch(int last_code)
+{
+    static INT32U t_start, t_leg, t_last;
+    static long   heading;             // + is clockwise (toward the right sensor)
+    static int    dir, limit;
+    INT32U now = hal_millis();
+    char   side = last_code == 1 || last_code == 3 || last_code == 4 || last_code == 6;
+
+    if (search == SEARCH_OFF || now - t_start > SEARCH_MAX_MS) {
+        if (search == SEARCH_OFF)
+            dir = (last_code == 4 || last_code == 6) ? -1 : 1;
+        search  = (side && search == SEARCH_OFF) ? SEARCH_BACKUP : SEARCH_AHEAD;
+        t_start = t_leg = t_last = now;
+        heading = 0;
+        limit   = SEARCH_DEG90;
+    }
+    heading += (long)(drive_left() - drive_right()) * (long)(now - t_last) >> 7;
+    t_last = now;
+
+    if (search == SEARCH_BACKUP && now - t_leg >= SEARCH_BACKUP_MS) {
+        search = SEARCH_SWEEP;
+        t_leg  = now;
+    } else if (search == SEARCH_AHEAD && now - t_leg >= SEARCH_GAP_MS) {
+        search = SEARCH_SWEEP;
+        t_leg  = now;
+    } else if (search == SEARCH_SWEEP && heading * dir >= limit) {
+        dir    = -dir;
+        limit += SEARCH_DEG90;
+        t_leg  = now;
+    }
+
+    switch (search)
     {
-        speed_r = myrobot.rspeed;
-        speed_l = myrobot.lspeed;
-        robo_motorSpeed(speed_l, speed_r);
-        OSTimeDlyHMSM(0, 0, 0, 100);
+        case SEARCH_BACKUP:
+            myrobot.lspeed = REVERSE_SPEED * 4 / 5;
+            myrobot.rspeed = REVERSE_SPEED * 4 / 5;
+            break;
+        case SEARCH_AHEAD:
+            myrobot.lspeed = LOW_SPEED;
+            myrobot.rspeed = LOW_SPEED;
+            break;
+        default:
+            myrobot.lspeed = dir * LOW_SPEED;
+            myrobot.rspeed = -dir * LOW_SPEED;
+            break;
     }
 }
 
 void Navig(void *data)
 {
-    static int lost_counter = 0;
-    static int recovery_direction = 1; // 1 for right, -1 for left
     static int last_valid_code = 2; // Default to middle sensor
     
     for (;;)
     {
-        int  code     = robo_lineSensor();
-        int  lightVal = robo_lightSensor();
-        char prox     = robo_proxSensor();
+        int  code     = tlm_lineSensor();
+        char light    = lightsens_update(tlm_lightSensor(), LIGHT_ON_DELTA, LIGHT_OFF_DELTA);
+        char prox     = tlm_proxSensor();
+        int  cruise, gentle, sharp, pos;
+        unsigned char conf;
+        char bar;
+        CpProfile prof;
+
+        wdog_checkin(TASK_NAVIG_PRIO);
+        conf = checkpoint_bar();
+        bar  = CHK_COUNTED(conf);
+        if (conf)
+            tlm_bar(conf, bar);
+
+        memcpy_P(&prof, &cp_profile[cp_state], sizeof(prof));
+        trackmap_step(cp_state, code, drive_left(), drive_right());
+        // Learned straight with room to brake before the next corner or bar
+        cruise = trackmap_fast(cp_state, code) ? HIGH_SPEED : MEDIUM_SPEED * prof.cruise_pct / 100;
+        gentle = TURN_GENTLE_PCT + prof.gentle_adj;
+        sharp  = TURN_SHARP_PCT + prof.sharp_adj;
 
         // Remember last valid line position when not lost
         if (code != 0) {
             last_valid_code = code;
-            lost_counter = 0;
+            search = SEARCH_OFF;
         }
         
         // Line following logic
         switch (code)
         {
             case 0: // All sensors off track - lost
-                // Implement progressive recovery strategy
-                lost_counter++;
-                
-                if (lost_counter < 5) {
-                    // First try backing up slightly
-                    myrobot.lspeed = REVERSE_SPEED * 0.8;
-                    myrobot.rspeed = REVERSE_SPEED * 0.8;
-                } else if (lost_counter < 15) {
-                    // Then try turning in the direction we last saw the line
-                    if (last_valid_code == 1 || last_valid_code == 3) {
-                        // Line was on the right, turn right
-                        myrobot.lspeed = LOW_SPEED;
-                        myrobot.rspeed = -LOW_SPEED;
-                    } else if (last_valid_code == 4 || last_valid_code == 6) {
-                        // Line was on the left, turn left
-                        myrobot.lspeed = -LOW_SPEED;
-                        myrobot.rspeed = LOW_SPEED;
-                    } else {
-                        // Try alternating directions in a widening spiral
-                        myrobot.lspeed = recovery_direction * MEDIUM_SPEED;
-                        myrobot.rspeed = -recovery_direction * MEDIUM_SPEED;
-                        
-                        if (lost_counter % 5 == 0) {
-                            recovery_direction = -recovery_direction; // Switch direction
-                        }
-                    }
-                } else {
-                    // If still lost after extended time, move forward a bit and try again
-                    myrobot.lspeed = LOW_SPEED;
-                    myrobot.rspeed = LOW_SPEED;
-                    
-                    if (lost_counter > 25) {
-                        lost_counter = 0; // Reset counter to start recovery again
-                    }
-                }
+                // Timed search toward where the line was last seen
+                lostSearch(last_valid_code);
                 break;
             case 1: // Right sensor on track
                 // Gentle correction when only right sensor detects the line
-                myrobot.lspeed = MEDIUM_SPEED;
-                myrobot.rspeed = MEDIUM_SPEED * 0.75;
+                myrobot.lspeed = cruise;
+                myrobot.rspeed = cruise * sharp / 100;
                 break;
             case 2: // Middle sensor on track - straight line
-                // Equal speeds for smooth straight movement
-                myrobot.lspeed = MEDIUM_SPEED;
-                myrobot.rspeed = MEDIUM_SPEED;
-                break;
             case 3: // Middle and right sensors on track
-                // Gentle right turn
-                myrobot.lspeed = MEDIUM_SPEED;
-                myrobot.rspeed = MEDIUM_SPEED * 0.85;
+            case 6: // Left and middle sensors on track
+                // Middle sensor on the line: slow the wheel on the line's side
+                // in proportion to the centroid, TURN_GENTLE_PCT where the
+                // middle and an outer sensor see it equally (3/6)
+                myrobot.lspeed = cruise;
+                myrobot.rspeed = cruise;
+                if (linesens_centroid(&pos) && pos != 0) {
+                    int inner = 100 - (pos < 0 ? -pos : pos) * (100 - gentle) / CENTROID_GENTLE;
+                    if (inner < sharp)
+                        inner = sharp;
+                    if (pos > 0)
+                        myrobot.rspeed = cruise * inner / 100;
+                    else
+                        myrobot.lspeed = cruise * inner / 100;
+                }
                 break;
             case 4: // Left sensor on track
                 // Gentle correction when only left sensor detects the line
-                myrobot.lspeed = MEDIUM_SPEED * 0.75;
-                myrobot.rspeed = MEDIUM_SPEED;
-                break;
-            case 6: // Left and middle sensors on track
-                // Gentle left turn
-                myrobot.lspeed = MEDIUM_SPEED * 0.85;
-                myrobot.rspeed = MEDIUM_SPEED;
+                myrobot.lspeed = cruise * sharp / 100;
+                myrobot.rspeed = cruise;
                 break;
             case 7: // All sensors on track - full bar
-                // Detected full bar: pause briefly then continue
-                myrobot.lspeed = STOP_SPEED;
-                myrobot.rspeed = STOP_SPEED;
-                OSTimeDlyHMSM(0, 0, 0, 150); // Shorter pause at the bar
-                myrobot.lspeed = LOW_SPEED;
-                myrobot.rspeed = LOW_SPEED;
-                OSTimeDlyHMSM(0, 0, 0, 100); // Gradual acceleration
-                myrobot.lspeed = MEDIUM_SPEED;
-                myrobot.rspeed = MEDIUM_SPEED;
+                // Drive straight across; checkpoint_sample() does the counting
+                myrobot.lspeed = cruise;
+                myrobot.rspeed = cruise;
                 break;
             case 5: // Left and right sensors on track (unusual case)
                 // Both outer sensors - go straight but slower
@@ -207,103 +374,95 @@ void Navig(void *data)
                 break;
         }
         
-        // Light sensor detection - values between 0-100, >70 is bright
-        if (lightVal > lightThreshold) {
-            // Only respond to new light detection
-            if (!myrobot.lightDetected) {
-                // Light newly detected - just honk once and continue movement
-                robo_Honk();
-                myrobot.lightDetected = 1;
-                
-                // Determine which light sensor we're detecting based on checkpoint state
-                if (cp_state < CP_C && !seenL1) {
-                    // Detected L1 (before checkpoint C)
-                    seenL1 = 1;
-                    myrobot.score += 5; // Rule 4 - Reaching A without detecting L1 earns 5 points
-                } else if (cp_state >= CP_C && !seenL2) {
-                    // Detected L2 (after checkpoint C)
-                    seenL2 = 1;
-                    
-                    // Rule 7.1 - After detecting L2, reverse back to main track
-                    if (cp_state == CP_D && !performedL2Task) {
-                        performedL2Task = 1;
-                        myrobot.score += 15; // Additional 15 points for completing L2 task
-                        
-                        // Reverse and turn to get back to main track
-                        myrobot.lspeed = REVERSE_SPEED;
-                        myrobot.rspeed = REVERSE_SPEED;
-                        robo_motorSpeed(myrobot.lspeed, myrobot.rspeed);
-                        OSTimeDlyHMSM(0, 0, 1, 0); // Reverse for 1 second
-                        
-                        // Turn to reorient to main track
-                        myrobot.lspeed = MEDIUM_SPEED;
-                        myrobot.rspeed = -LOW_SPEED;
-                        robo_motorSpeed(myrobot.lspeed, myrobot.rspeed);
-                        OSTimeDlyHMSM(0, 0, 1, 500); // Turn for 1.5 seconds
-                    }
+        // Lamp edges against the ambient baseline (lightsens.c)
+        if (light == LIGHT_RISE) {
+            // Lamp newly seen - just honk once and continue movement
+            robo_Honk();
+            robo_LED_on();              // kept on while the lamp is seen
+            tlm_lamp(prof.light == LIGHT_L1 ? 1 : 2, 1);
+
+            // Determine which light sensor we're detecting based on checkpoint state
+            if (prof.light == LIGHT_L1 && !seenL1) {
+                // Detected L1 (before checkpoint C)
+                seenL1 = 1;
+                myrobot.score += 5; // Rule 4 - Reaching A without detecting L1 earns 5 points
+            } else if (prof.light != LIGHT_L1 && !seenL2) {
+                // Detected L2 (after checkpoint C)
+                seenL2 = 1;
+
+                // Rule 7.1 - After detecting L2, reverse back to main track
+                if (prof.light == LIGHT_L2_TASK && !performedL2Task) {
+                    performedL2Task = 1;
+                    myrobot.score += 15; // Additional 15 points for completing L2 task
+
+                    // Reverse and turn to get back to main track
+                    myrobot.lspeed = REVERSE_SPEED;
+                    myrobot.rspeed = REVERSE_SPEED;
+                    steer();
+                    DELAY_MS(1000); // Reverse for 1 second
+
+                    // Turn to reorient to main track
+                    myrobot.lspeed = MEDIUM_SPEED;
+                    myrobot.rspeed = -LOW_SPEED;
+                    steer();
+                    turnToLine(MS_TO_TICKS(1500), L2_TURN_MIN); // Up to 1.5 s, until back on a line
                 }
             }
-            // Keep LED on while light is detected
-            robo_LED_on();
-        } else {
-            // No bright light detected
-            if (myrobot.lightDetected) {
-                // Turn off LED if we were previously detecting light
-                robo_LED_off();
-                myrobot.lightDetected = 0;
-            }
+        } else if (light == LIGHT_FALL) {
+            robo_LED_off();
+            tlm_lamp(prof.light == LIGHT_L1 ? 1 : 2, 0);
         }
         
         // Checkpoint detection and scoring
         switch (cp_state)
         {
             case CP_START:
-                if (code == 7) { // Full bar at start line
+                if (bar) { // Full bar at start line
                     cp_state = CP_A;
                 }
                 break;
             case CP_A:
-                if (code == 7) { // Full bar at checkpoint A
+                if (bar) { // Full bar at checkpoint A
                     cp_state = CP_B;
                     myrobot.score += 5; // Rule 5 - Reaching B earns 5 points
                     
                     // Rule 4.1 - Detecting light L1 and making LED blink earns 10 points
                     if (seenL1) {
-                        blinkLED(3, 150);
+                        blinkLED(3, MS_TO_TICKS(150));
                         myrobot.score += 10;
                     }
                 }
                 break;
             case CP_B:
-                if (code == 7) { // Full bar at checkpoint B
+                if (bar) { // Full bar at checkpoint B
                     cp_state = CP_C;
                     myrobot.score += 5; // Rule 6 - Reaching C earns 5 points
                     robo_LED_toggle();
                 }
                 break;
             case CP_C:
-                if (code == 7) { // Full bar at checkpoint C
+                if (bar) { // Full bar at checkpoint C
                     cp_state = CP_D;
                     myrobot.score += 5; // Rule 7 - Reaching D earns 5 points
                     robo_LED_toggle();
                 }
                 break;
             case CP_D:
-                if (code == 7) { // Full bar at checkpoint D
+                if (bar) { // Full bar at checkpoint D
                     cp_state = CP_E;
                     myrobot.score += 5; // Rule 8 - Reaching E earns 5 points
                     robo_LED_toggle();
                 }
                 break;
             case CP_E:
-                if (code == 7) { // Full bar at checkpoint E
+                if (bar) { // Full bar at checkpoint E
                     cp_state = CP_F;
                     myrobot.score += 5; // Rule 9 - Reaching F earns 5 points
                     robo_LED_toggle();
                 }
                 break;
             case CP_F:
-                if (code == 7) { // Full bar at finish line
+                if (bar) { // Full bar at finish line
                     cp_state = CP_DONE;
                     myrobot.score += 5; // Rule 10 - Reaching the end earns 5 points
                     robo_LED_on(); // Keep LED on at finish
@@ -317,85 +476,225 @@ void Navig(void *data)
                 // Robot has completed the course
                 myrobot.lspeed = STOP_SPEED;
                 myrobot.rspeed = STOP_SPEED;
+                trackmap_lap_done(); // Standing still now; save the map of a learning lap
                 break;
         }
+        steer();                        // during obstacle recovery CheckCollision's target holds
+        tlm_cpState(cp_state);
+        rtmon_done(TASK_NAVIG_PRIO);
 
-        // Apply motor speeds - only if not in obstacle recovery mode
-        // The CheckCollision task handles motor control during obstacle recovery
-        if (myrobot.obstacle) {
-            // Obstacle handling is done in CheckCollision task
-            // Don't override those motor commands here
-        } else {
-            robo_motorSpeed(myrobot.lspeed, myrobot.rspeed);
-            
-            // Add a small delay when performing recovery maneuvers
-            if (code == 0 && lost_counter > 0) {
-                OSTimeDlyHMSM(0, 0, 0, 50); // Shorter delay during recovery
-            }
-            
-            // Add a small delay between sensor readings to reduce jitter
-            if (code == 2) {
-                // On straight line, no additional delay needed
-            } else if (code == 3 || code == 6) {
-                // Small delay for gentle turns
-                OSTimeDlyHMSM(0, 0, 0, 20);
-            }
+        if (!myrobot.obstacle && (code == 3 || code == 6)) {
+            // Small delay for gentle turns to reduce jitter
+            DELAY_MS(20);
         }
         
-        OSTimeDlyHMSM(0, 0, 0, 100);
+        barWait(MS_TO_TICKS(100));
     }
 }
 
-void blinkLED(char times, int interval_ms)
+void blinkLED(char times, INT16U interval_ticks)
 {
     int i;
     for (i = 0; i < times; i++)
     {
         robo_LED_on();
-        OSTimeDlyHMSM(0, 0, 0, interval_ms);
+        OSTimeDly(interval_ticks);
         robo_LED_off();
-        OSTimeDlyHMSM(0, 0, 0, interval_ms);
+        OSTimeDly(interval_ticks);
     }
 }
 
+// HAL_TICK_UNIT_US counts in us for a J line; a tick held off 33 ms or
+// more no longer fits an int and reads as 32767
+static int tickUs(INT32U units)
+{
+    INT32U us = units * HAL_TICK_UNIT_US;
+
+    return us > 32767 ? 32767 : (int)us;
+}
+
+// Tick interval over the last report, so jitter shows in the telemetry
+static void reportTick(void)
+{
+    struct hal_tick_stats ts;
+
+    hal_tick_stats(&ts);
+    if (ts.n)
+        tlm_tick(tickUs(ts.min), tickUs(ts.max), tickUs(ts.sum / ts.n));
+}
+
+// Estimated MCU current from the time asleep, and wakes per second, over the last report
+static void reportIdle(void)
+{
+    struct hal_idle_stats is;
+    INT32U ms;
+
+    hal_idle_stats(&is);
+    ms = is.span / (1000 / HAL_TICK_UNIT_US);
+    if (ms == 0)
+        return;
+    if (is.slept > is.span)
+        is.slept = is.span;
+    tlm_idle(HAL_MCU_ACTIVE_UA - (INT32U)(HAL_MCU_ACTIVE_UA - HAL_MCU_IDLE_UA)
+                                 * (is.slept >> 4) / (is.span >> 4),
+             (int)((INT32U)is.wakes * 1000 / ms));
+}
+
+#define TASK_DESC(fn, prio, stk, wdog, period)      { fn, fn##Stk, stk, prio, wdog, period },
+static const struct task_desc task_table[] PROGMEM = { TASKS(TASK_DESC) };
+#define TASK_COUNT          (sizeof(task_table) / sizeof(task_table[0]))
+
+// TaskStart runs the jobs and sleeps the CPU, so no task may sit below it;
+// its priority is then the last slot of the wdog.c and rtmon.c arrays
+typedef char task_start_lowest[TASK_START_PRIO + 1 == TASK_NPRIO ? 1 : -1];
+
+// OSTCBTbl is built into kernel.o with room for OS_MAX_TASKS application tasks
+#ifndef OS_MAX_TASKS
+#error "kernel.h does not give OS_MAX_TASKS; define it as kernel.o was built"
+#endif
+typedef char task_table_fits[TASK_COUNT <= OS_MAX_TASKS ? 1 : -1];
+
+// Before OSStart(), while no task stack is in use
+static void fillStacks(void)
+{
+    struct task_desc t;
+    INT8U i;
+
+    for (i = 0; i < TASK_COUNT; i++) {
+        memcpy_P(&t, &task_table[i], sizeof(t));
+        memset(t.stk, STK_FILL, t.stk_size);
+    }
+}
+
+static void createTask(INT8U i)
+{
+    struct task_desc t;
+
+    memcpy_P(&t, &task_table[i], sizeof(t));
+    if (t.wdog_ms)                      // first: created by TaskStart, the task runs at once
+        wdog_watch(t.prio, t.wdog_ms);
+    if (t.period_ms)
+        rtmon_watch(t.prio, t.period_ms);
+    OSTaskCreate(t.fn, (void*)0, &t.stk[t.stk_size-1], t.prio);
+}
+
+// Bytes of the stack ever used; the stack grows down from its end
+INT16U stackUsed(const struct task_desc *t)
+{
+    INT16U n = 0;
+
+    while (n < t->stk_size && t->stk[n] == STK_FILL)
+        n++;
+    return t->stk_size - n;
+}
+
+// Response times since power-on and stack high-water marks of every task
+static void reportTasks(void)
+{
+    struct task_desc t;
+    struct rtmon_stats st;
+    INT8U i;
+
+    for (i = 0; i < TASK_COUNT; i++) {
+        memcpy_P(&t, &task_table[i], sizeof(t));
+        if (t.period_ms) {
+            rtmon_stats(t.prio, &st);
+            tlm_task(t.prio, st.wcrt, st.jobs ? (int)(st.sum / st.jobs) : 0, st.misses);
+        }
+        tlm_stack(t.prio, stackUsed(&t), t.stk_size);
+    }
+}
+
+static void pollRequests(void)
+{
+    if (tlm_request() == 'r')
+        reportTasks();
+}
+
+static void reportStatus(void)
+{
+    reportTick();
+    reportIdle();
+}
+
+/*
+ *   Starts the board and the other tasks, then runs the periodic chores as
+ *   jobs (jobs.c) on this one stack.  It is the lowest task, so the
+ *   others preempt the jobs as they would preempt OS_TaskIdle; and as
+ *   OS_TaskIdle only spins, its hook being built into kernel.o, this task
+ *   takes its place: with no job due it sleeps the CPU until the next
+ *   interrupt, which may make a task ready.
+ */
 void TaskStart(void *data)
 {
+    INT8U i;
+
     OS_ticks_init();
+    hal_clock_init();
+    hal_tick_init();                    // the tick from here on follows the Timer2 clock
+    tlm_start();
+    if (wdog_culprit != WDOG_NONE) {
+        struct wdog_log log;
 
-    OSTaskCreate(CheckCollision, (void*)0,
-                &ChkCollideStk[TASK_STK_SZ-1],
-                TASK_CHKCOLLIDE_PRIO);
+        wdog_log(&log);
+        tlm_wdog(log.resets, log.culprit);
+    }
+    drive_battery();
 
-    OSTaskCreate(CntrlMotors, (void*)0,
-                &CtrlmotorStk[TASK_STK_SZ-1],
-                TASK_CTRLMOTOR_PRIO);
+    // Calibrate on the straight, then wait to be put back at the start
+    if (calibrate) {
+        if (!calib_run())
+            robo_Honk();                // not on the line, or lost it
+        robo_wait4goPress();
+    }
 
-    OSTaskCreate(Navig, (void*)0,
-                &NavigStk[TASK_STK_SZ-1],
-                TASK_NAVIG_PRIO);
+    drive_start();                      // the Timer2 interrupt drives the wheels from here on
+    for (i = 1; i < TASK_COUNT; i++)
+        createTask(i);
+    wdog_start();
 
+    jobs_add(pollRequests, JOB_POLL_MS, 0);
+    jobs_add(drive_report, JOB_FLUSH_MS, 0);
+    jobs_add(robo_LED_toggle, JOB_HEARTBEAT_MS, JOB_HEARTBEAT_MS);
+    jobs_add(drive_battery, JOB_BATTERY_MS, JOB_BATTERY_OFFSET);    // battery feed-forward for the wheel PWM
+    jobs_add(reportStatus, JOB_REPORT_MS, JOB_REPORT_OFFSET);
     for (;;)
     {
-        OSTimeDlyHMSM(0, 0, 5, 0);
-        robo_LED_toggle();
+        wdog_checkin(TASK_START_PRIO);
+        jobs_run();
+        hal_idle_sleep();
     }
 }
 
 int main(void)
 {
     robo_Setup();
+    wdog_culprit = wdog_boot();        // a task was stuck: logged to EEPROM, wheels stay stopped
     OSInit();
+    trackmap_init(robo_bumpSensorL()); // Hold the left bumper at power-on to relearn the track
+    calibrate = robo_goPressed();      // Hold go at power-on to calibrate the wheels first
+    linesens_init();
+
+    // Filtered in the ADC ISR once TaskStart starts the clock; ADC_read() would fight it
+    adcscan_init();
+    adcscan_filter(ADC_PROX, ADC_FILT_MEDIAN3, 0);          // a glint must not stop the robot
+    adcscan_filter(LS_ADC_FIRST + LS_LEFT, ADC_FILT_MEDIAN3, 0);    // nor a speck steer it
+    adcscan_filter(LS_ADC_FIRST + LS_MIDDLE, ADC_FILT_MEDIAN3, 0);
+    adcscan_filter(LS_ADC_FIRST + LS_RIGHT, ADC_FILT_MEDIAN3, 0);
+    adcscan_filter(LIGHT_ADC, ADC_FILT_IIR, 1);             // ~8 ms
+    adcscan_filter(DRIVE_ADC_BATT, ADC_FILT_IIR, 4);        // ~64 ms, through motor current spikes
 
-    robo_motorSpeed(STOP_SPEED, STOP_SPEED);
+    drive_init(SLEW_ACCEL, SLEW_DECEL);
+    if (wdog_culprit != WDOG_NONE)
+        drive_stop();
     myrobot.rspeed   = STOP_SPEED;
     myrobot.lspeed   = STOP_SPEED;
     myrobot.obstacle = 0;
+    myrobot.obstacle_speed = STOP_SPEED;
     myrobot.score    = 0;
-    myrobot.lightDetected = 0;
 
-    OSTaskCreate(TaskStart, (void*)0,
-                &TaskStartStk[TASK_STK_SZ-1],
-                TASK_START_PRIO);
+    fillStacks();
+    createTask(0);                      // TaskStart; it creates the rest
 
     robo_Honk();
     robo_wait4goPress();
@@ -0,0 +1,27 @@
+/*
+ *   ROBOTUNE.H -- Speed and threshold constants for robosample.c
+ *
+ *   This file may be regenerated by the gain optimizer in sim/ (see
+ *   sim/src/optimize.c).  Hand edits are fine; keep the names unchanged.
+ */
+
+#ifndef ROBOTUNE_H
+#define ROBOTUNE_H
+
+#define STOP_SPEED        0
+#define VERY_LOW_SPEED   20
+#define LOW_SPEED        30
+#define MEDIUM_SPEED     45
+#define HIGH_SPEED       55
+#define REVERSE_SPEED   -25
+
+#define TURN_GENTLE_PCT  85     // inner wheel % of cruise on codes 3/6
+#define TURN_SHARP_PCT   75     // inner wheel % of cruise on codes 1/4
+
+#define LIGHT_ON_DELTA   40     // light level (0-100) above ambient taken as a lamp
+#define LIGHT_OFF_DELTA  25     // and below which the lamp is left behind
+
+#define SLEW_ACCEL        8     // wheel speed change per tick, speeding up
+#define SLEW_DECEL       12     // wheel speed change per tick, slowing down
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ *   RTMON.C -- Per-task response time and deadline misses; see rtmon.h
+ */
+
+#include "rtmon.h"
+#include "hal_ext.h"
+#include "tasks.h"
+
+static struct rtmon_stats st[TASK_NPRIO];     // by priority
+static INT32U release[TASK_NPRIO];      // hal_millis() time; 0 = not released yet
+
+void rtmon_watch(INT8U prio, INT16U deadline_ms)
+{
+    if (prio < TASK_NPRIO)
+        st[prio].deadline = deadline_ms;
+}
+
+void rtmon_dly(INT8U prio, INT16U ticks)
+{
+    INT32U due = hal_tick_millis() + (INT32U)ticks * HAL_TICK_MS;
+
+    OSTimeDly(ticks);
+    if (prio < TASK_NPRIO)
+        release[prio] = due;
+}
+
+void rtmon_done(INT8U prio)
+{
+    struct rtmon_stats *s;
+    INT32U r;
+
+    if (prio >= TASK_NPRIO)
+        return;
+    s = &st[prio];
+    if (!s->deadline || !release[prio])
+        return;
+    r = hal_millis() - release[prio];
+    release[prio] = 0;
+    if (r > 0xffff)
+        r = 0xffff;
+    s->jobs++;
+    s->sum += r;
+    if (r > s->wcrt)
+        s->wcrt = r;
+    if (r > s->deadline && s->misses < 0xffff)
+        s->misses++;
+}
+
+void rtmon_stats(INT8U prio, struct rtmon_stats *s)
+{
+    *s = st[prio];
+}
@@ -0,0 +1,35 @@
+/*
+ *   RTMON.H -- Per-task response time and deadline misses
+ *
+ *   A monitored task ends each job with rtmon_done() and waits for the
+ *   next with rtmon_dly() in place of OSTimeDly().  The job is released
+ *   at the OS tick that ends the last rtmon_dly() before it, whether or
+ *   not a higher priority task then keeps it waiting, and its response
+ *   time runs from there to rtmon_done(), in ms.  Other delays within a
+ *   job, such as Navig's obstacle maneuver, count as part of it.  A
+ *   response longer than the task's deadline is a miss.
+ *
+ *   The counts run from power-on; telemetry.c prints them on request
+ *   (see telemetry.h).
+ */
+
+#ifndef RTMON_H
+#define RTMON_H
+
+#include "../inc/kernel.h"
+
+struct rtmon_stats
+{
+    INT32U jobs;
+    INT32U sum;                         // ms, for the mean response
+    INT16U wcrt;                        // worst-case response, ms
+    INT16U misses;                      // saturating
+    INT16U deadline;                    // ms; 0 = not monitored
+};
+
+void rtmon_watch(INT8U prio, INT16U deadline_ms);  // prio from tasks.h; above every task there, ignored
+void rtmon_dly(INT8U prio, INT16U ticks);
+void rtmon_done(INT8U prio);
+void rtmon_stats(INT8U prio, struct rtmon_stats *s);
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ *   PGMSPACE.H -- Host stand-in for avr-libc <avr/pgmspace.h>
+ *
+ *   The host has one address space, so flash data is ordinary const data.
+ */
+
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define pgm_read_byte(p)        (*(const unsigned char *)(p))
+#define pgm_read_word(p)        (*(const unsigned short *)(p))
+#define memcpy_P(dst, src, n)   memcpy((dst), (src), (n))
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ *   HAL_ROBO.H -- Host stand-in for the RoboKar hardware abstraction layer
+ *
+ *   Same entry points as hal_robo.o on the ATmega328P.  The implementation in
+ *   sim/src/hal_sim.c reads the sensors from the simulated track and drives
+ *   the simulated wheels; blocking HAL calls are charged as CPU time.
+ */
+
+#ifndef HAL_ROBO_H
+#define HAL_ROBO_H
+
+void robo_Setup(void);
+void HAL_init(void);
+void OS_ticks_init(void);
+
+unsigned int ADC_read(unsigned char channel);
+
+void motor_init(void);
+void motor_set_speed(char motor, int speed);
+void motor_set_dir(char motor, char dir);
+void robo_motorSpeed(int lspeed, int rspeed);
+
+int  robo_proxSensor(void);
+int  robo_lightSensor(void);
+int  robo_lineSensor(void);
+int  robo_bumpSensorR(void);
+int  robo_bumpSensorL(void);
+void robo_checkBattery(void);
+
+char robo_goPressed(void);
+void robo_wait4goPress(void);
+void robo_Honk(void);
+void robo_LED_on(void);
+void robo_LED_off(void);
+void robo_LED_toggle(void);
+
+void USART0_init(unsigned int ubrr);
+void cputchar(char c);
+char cgetchar(void);
+void cputs(const char *s);
+void cprintf(const char *fmt, ...);
+
+#endif
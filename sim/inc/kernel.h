@@ -0,0 +1,45 @@
+/*
+ *   KERNEL.H -- Host stand-in for the RTprog uC/OS-II kernel header
+ *
+ *   Only the part of the kernel API used by robosample.c is declared.  The
+ *   implementation in sim/src/kernel_sim.c runs every task in virtual time:
+ *   one OS tick is one physics step of the track model.
+ */
+
+#ifndef KERNEL_H
+#define KERNEL_H
+
+typedef unsigned char  BOOLEAN;
+typedef unsigned char  INT8U;
+typedef signed   char  INT8S;
+typedef unsigned short INT16U;
+typedef signed   short INT16S;
+typedef unsigned int   INT32U;
+typedef signed   int   INT32S;
+typedef INT8U          OS_STK;
+
+#define OS_TICKS_PER_SEC    100         // Same as the target (Timer0 reload of 100 at /1024)
+#define OS_LOWEST_PRIO      16
+#define OS_IDLE_PRIO        OS_LOWEST_PRIO
+#define OS_MAX_TASKS        OS_LOWEST_PRIO  // kernel_sim.c keeps a TCB per priority
+
+#define OS_NO_ERR           0
+#define OS_PRIO_EXIST       40
+#define OS_PRIO_INVALID     42
+#define OS_TIME_INVALID_MINUTES  81
+#define OS_TIME_INVALID_SECONDS  82
+#define OS_TIME_INVALID_MILLI    83
+#define OS_TIME_ZERO_DLY         84
+
+extern volatile INT8U  OSRunning;
+extern volatile INT32U OSIdleCtr;
+extern volatile INT32U OSCtxSwCtr;
+
+void   OSInit(void);
+void   OSStart(void);
+INT8U  OSTaskCreate(void (*task)(void *pd), void *pdata, OS_STK *ptos, INT8U prio);
+void   OSTimeDly(INT16U ticks);
+INT8U  OSTimeDlyHMSM(INT8U hours, INT8U minutes, INT8U seconds, INT16U milli);
+void   OSTimeTick(void);
+
+#endif
@@ -0,0 +1,525 @@
+/*
+ *   AVRBENCH.C -- Cycle counts of the real firmware image under simavr
+ *
+ *   Loads default/robosample.elf into a simulated ATmega328P at 16 MHz,
+ *   presses GO, drives the ADC inputs from a sensor waveform and steps the
+ *   core one instruction at a time.  Addresses come from the ELF symbol
+ *   table, so the same harness works on any rebuild:
+ *
+ *     isr_latency     Timer2 compare flag OCF2A set -> first instruction of
+ *                     its vector; Timer0 is overflowed by that ISR, not by
+ *                     the clock, so its flag would time the ISR instead
+ *     tick_isr        OSTickISR entry -> its reti, or the ret of OSIntCtxSw
+ *                     when that resumes a task switched out in OSCtxSw
+ *     ostimetick      OSTimeTick entry -> its ret
+ *     ctxsw           OSCtxSw entry -> its ret into the next task
+ *     int_ctxsw       OSIntCtxSw entry -> its ret
+ *     tick_period     OSTickISR entry -> the next; max - min is the tick
+ *                     jitter (hal_ext.h)
+ *     navig_loop      cycles Navig itself ran between two loop-head calls
+ *                     (linesens_code by default): on NavigStk, outside every
+ *                     interrupt vector and outside OSCtxSw, since rta adds
+ *                     the isr and ctxsw lines of tasks.rta on top of it
+ *
+ *   plus the cycles each task stack was active (interrupts included, and
+ *   also totalled on their own) and, per stack, the most bytes interrupts
+ *   took on top of the task: from its SP when the first one came in to
+ *   the lowest SP before the reti back to it.  OSTickISR re-enables
+ *   interrupts, so Timer2 (wdog_isr, drive_isr), ADC or UART can nest on
+ *   it; isr_stack.max_depth says whether they did.  The report is JSON.
+ *
+ *   The waveform file has one row per change: time in ms, then the ADC
+ *   counts of channels 0-5 (prox, line L/M/R, light, battery).  Each row
+ *   holds until the next.  Without -w a built-in course is used: a line
+ *   drifting under the three sensors, a full bar every 2 s, a lamp pulse
+ *   and an obstacle.
+ *
+ *   usage: avrbench [-t ms] [-w wave.csv] [-m loop_symbol] [-o report.json]
+ *                   [robosample.elf]
+ */
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "avr_adc.h"
+#include "avr_ioport.h"
+#include "../../tasks.h"
+
+#define F_CPU               16000000UL
+#define CYCLES_PER_MS       (F_CPU / 1000)
+#define TIMER2_COMPA_VECTOR 7
+#define VECTOR_SIZE         4
+#define VECTOR_COUNT        26          // ATmega328P, reset included
+#define TIFR2_ADDR          (0x17 + 0x20)
+#define OCF2A_BIT           0x02
+#define DATA_OFFSET         0x800000UL
+#define OP_RET              0x9508
+#define OP_RETI             0x9518
+#define ADC_CHANNELS        6
+#define MAX_SYMS            1024
+#define MAX_WAVE            4096
+
+/* ------------------------------------------------------------------------
+ *  ELF symbol table
+ * ------------------------------------------------------------------------ */
+
+struct sym
+{
+    char     name[32];
+    uint32_t addr;
+    uint32_t size;
+    char     data;                      // lives in SRAM (0x800000 + address)
+};
+
+static struct sym syms[MAX_SYMS];
+static int nsyms;
+
+static int load_symbols(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    Elf32_Ehdr eh;
+    Elf32_Shdr *sh = 0;
+    int i, ok = -1;
+
+    if (!f)
+        return -1;
+    if (fread(&eh, sizeof(eh), 1, f) != 1 || memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh.e_ident[EI_CLASS] != ELFCLASS32)
+        goto out;
+    if (!(sh = calloc(eh.e_shnum, sizeof(*sh))))
+        goto out;
+    if (fseek(f, eh.e_shoff, SEEK_SET) != 0 || fread(sh, sizeof(*sh), eh.e_shnum, f) != eh.e_shnum)
+        goto out;
+    for (i = 0; i < eh.e_shnum; i++) {
+        Elf32_Shdr *st = &sh[i], *str;
+        char *names;
+        Elf32_Sym *tab;
+        unsigned k, n;
+
+        if (st->sh_type != SHT_SYMTAB || st->sh_link >= eh.e_shnum)
+            continue;
+        str = &sh[st->sh_link];
+        n = st->sh_size / sizeof(Elf32_Sym);
+        names = malloc(str->sh_size);
+        tab = malloc(st->sh_size);
+        if (names && tab && fseek(f, str->sh_offset, SEEK_SET) == 0 &&
+            fread(names, 1, str->sh_size, f) == str->sh_size &&
+            fseek(f, st->sh_offset, SEEK_SET) == 0 && fread(tab, sizeof(*tab), n, f) == n) {
+            for (k = 0; k < n && nsyms < MAX_SYMS; k++) {
+                const char *nm = names + tab[k].st_name;
+                int type = ELF32_ST_TYPE(tab[k].st_info);
+                if (!*nm || tab[k].st_name >= str->sh_size ||
+                    (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE))
+                    continue;
+                snprintf(syms[nsyms].name, sizeof(syms[nsyms].name), "%s", nm);
+                syms[nsyms].data = tab[k].st_value >= DATA_OFFSET;
+                syms[nsyms].addr = tab[k].st_value & 0xffff;
+                syms[nsyms].size = tab[k].st_size;
+                nsyms++;
+            }
+            ok = 0;
+        }
+        free(names);
+        free(tab);
+    }
+out:
+    free(sh);
+    fclose(f);
+    return ok;
+}
+
+static const struct sym *sym_find(const char *name, char data)
+{
+    int i;
+
+    for (i = 0; i < nsyms; i++)
+        if (syms[i].data == data && strcmp(syms[i].name, name) == 0)
+            return &syms[i];
+    return 0;
+}
+
+/* End of a code symbol: its size, else the next global code label */
+static uint32_t sym_end(const struct sym *s)
+{
+    uint32_t end = 0xffffffff;
+    int i;
+
+    if (s->size)
+        return s->addr + s->size;
+    for (i = 0; i < nsyms; i++)
+        if (!syms[i].data && syms[i].addr > s->addr && syms[i].addr < end &&
+            syms[i].name[0] != '_' && syms[i].name[0] != '.')
+            end = syms[i].addr;
+    return end;
+}
+
+/* ------------------------------------------------------------------------
+ *  Statistics
+ * ------------------------------------------------------------------------ */
+
+struct tally
+{
+    const char *name;
+    unsigned long n;
+    uint64_t min, max, sum;
+};
+
+static void stat_add(struct tally *s, uint64_t v)
+{
+    if (s->n == 0 || v < s->min)
+        s->min = v;
+    if (v > s->max)
+        s->max = v;
+    s->sum += v;
+    s->n++;
+}
+
+/* A code region timed from entry to the first ret/reti executed inside it */
+struct span
+{
+    struct tally st;
+    uint32_t lo, hi;
+    uint64_t t0;
+    char     active;
+};
+
+static int span_init(struct span *sp, const char *sym, const char *name)
+{
+    const struct sym *s = sym_find(sym, 0);
+
+    memset(sp, 0, sizeof(*sp));
+    sp->st.name = name;
+    if (!s)
+        return -1;
+    sp->lo = s->addr;
+    sp->hi = sym_end(s);
+    return 0;
+}
+
+static void span_step(struct span *sp, uint32_t pc, uint16_t op, uint64_t cyc)
+{
+    if (!sp->hi)
+        return;
+    if (!sp->active && pc == sp->lo) {
+        sp->active = 1;
+        sp->t0 = cyc;
+    }
+    if (sp->active && pc >= sp->lo && pc < sp->hi && (op == OP_RET || op == OP_RETI))
+        sp->active = 2;                 // ends once this instruction has run
+}
+
+static int span_after(struct span *sp, uint64_t cyc)
+{
+    if (sp->active != 2)
+        return 0;
+    stat_add(&sp->st, cyc - sp->t0);
+    sp->active = 0;
+    return 1;
+}
+
+/* ------------------------------------------------------------------------
+ *  Sensor waveform
+ * ------------------------------------------------------------------------ */
+
+struct wave_row
+{
+    uint32_t ms;
+    uint16_t adc[ADC_CHANNELS];
+};
+
+static struct wave_row wave[MAX_WAVE];
+static int nwave;
+
+static int wave_read(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[160];
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f) && nwave < MAX_WAVE) {
+        struct wave_row *r = &wave[nwave];
+        unsigned v[ADC_CHANNELS + 1];
+        int k;
+        if (sscanf(line, "%u,%u,%u,%u,%u,%u,%u", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7)
+            continue;                   // header or comment
+        r->ms = v[0];
+        for (k = 0; k < ADC_CHANNELS; k++)
+            r->adc[k] = v[k + 1] > 1023 ? 1023 : v[k + 1];
+        nwave++;
+    }
+    fclose(f);
+    return nwave ? 0 : -1;
+}
+
+/* 20 s of line following: drift left and right, a bar every 2 s, L1 at 5 s,
+ * an obstacle at 9 s; 60 ms steps */
+static void wave_builtin(void)
+{
+    static const unsigned char drift[] = { 2, 2, 3, 3, 1, 3, 2, 2, 6, 6, 4, 6, 2, 2, 0, 2 };
+    uint32_t ms;
+
+    for (ms = 0; ms < 20000 && nwave < MAX_WAVE; ms += 60) {
+        struct wave_row *r = &wave[nwave++];
+        int code = drift[(ms / 60) % sizeof(drift)];
+        if (ms % 2000 < 60)
+            code = 7;
+        r->ms = ms;
+        r->adc[0] = ms >= 9000 && ms < 10500 ? 40 : 600;
+        r->adc[1] = code & 4 ? 120 : 700;
+        r->adc[2] = code & 2 ? 120 : 700;
+        r->adc[3] = code & 1 ? 120 : 700;
+        r->adc[4] = ms >= 5000 && ms < 5600 ? 200 : 800;    // light level 81 vs 21
+        r->adc[5] = 757;                                    // 7.4 V at DRIVE_BATT_FULL_MV 10000
+    }
+}
+
+/* ------------------------------------------------------------------------
+ *  Run
+ * ------------------------------------------------------------------------ */
+
+// <task>Stk for every task in tasks.h, as robosample.c names them, then the kernel's
+#define TASK_STACK_NAME(fn, prio, stk, wdog, period)    #fn "Stk",
+static const char *task_stacks[] = { TASKS(TASK_STACK_NAME) "OSTaskIdleStk" };
+#define NTASKS  (int)(sizeof(task_stacks) / sizeof(task_stacks[0]))
+
+static const struct sym *stk[NTASKS];
+
+/* Index into task_stacks[] of the stack sp is in, NTASKS if none */
+static int stack_of(uint16_t sp)
+{
+    int i;
+
+    for (i = 0; i < NTASKS; i++)
+        if (stk[i] && sp >= stk[i]->addr && sp < stk[i]->addr + stk[i]->size)
+            break;
+    return i;
+}
+
+/* Interrupts stacked on a task, first vector entry to the last reti */
+struct isr_stack
+{
+    int      depth, max_depth;
+    int      task;                      // stack_of() the task interrupted
+    uint16_t base, low;                 // its SP before the first, lowest SP since
+    unsigned max[NTASKS + 1];           // bytes, per stack
+};
+
+static void isr_stack_end(struct isr_stack *is)
+{
+    if (is->base - is->low > is->max[is->task])
+        is->max[is->task] = is->base - is->low;
+    is->depth = 0;
+}
+
+static void print_stat(FILE *f, const struct tally *s, int last)
+{
+    fprintf(f, "    \"%s\": { \"n\": %lu", s->name, s->n);
+    if (s->n)
+        fprintf(f, ", \"min\": %llu, \"mean\": %.1f, \"max\": %llu",
+                (unsigned long long)s->min, (double)s->sum / s->n, (unsigned long long)s->max);
+    fprintf(f, " }%s\n", last ? "" : ",");
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: avrbench [-t ms] [-w wave.csv] [-m loop_symbol] [-o report.json]\n"
+                    "                [robosample.elf]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *elf = "../default/robosample.elf", *out = 0, *wpath = 0, *loop_sym = "linesens_code";
+    uint32_t run_ms = 10000;
+    elf_firmware_t fw;
+    avr_t *avr;
+    avr_irq_t *adc[ADC_CHANNELS], *go;
+    struct span spans[4];
+    struct tally latency = { "isr_latency" }, navig = { "navig_loop" }, period = { "tick_period" };
+    const struct sym *navig_stk, *loop;
+    struct isr_stack istk;
+    uint64_t task_cycles[NTASKS + 1], flag_cycle = 0, end, navig_acc = 0, isr_depth_cycles = 0, last_tick = 0;
+    uint32_t vec_pc = TIMER2_COMPA_VECTOR * VECTOR_SIZE;
+    int opt, i, k, w = -1, state, navig_started = 0, go_level = 1;
+    uint8_t last_tifr = 0;
+    FILE *f = stdout;
+
+    while ((opt = getopt(argc, argv, "t:w:m:o:")) != -1) {
+        switch (opt)
+        {
+            case 't': run_ms = strtoul(optarg, 0, 0); break;
+            case 'w': wpath = optarg; break;
+            case 'm': loop_sym = optarg; break;
+            case 'o': out = optarg; break;
+            default: usage();
+        }
+    }
+    if (optind < argc)
+        elf = argv[optind];
+
+    if (load_symbols(elf) < 0) {
+        fprintf(stderr, "avrbench: no symbol table in %s\n", elf);
+        return 2;
+    }
+    if (!wpath) {
+        wave_builtin();
+    } else if (wave_read(wpath) < 0) {
+        fprintf(stderr, "avrbench: no waveform rows in %s\n", wpath);
+        return 2;
+    }
+    memset(&fw, 0, sizeof(fw));
+    if (elf_read_firmware(elf, &fw) != 0) {
+        fprintf(stderr, "avrbench: cannot load %s\n", elf);
+        return 2;
+    }
+    fw.frequency = F_CPU;
+    if (!(avr = avr_make_mcu_by_name("atmega328p"))) {
+        fprintf(stderr, "avrbench: simavr has no atmega328p core\n");
+        return 2;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &fw);
+    avr->frequency = F_CPU;
+    avr->vcc = avr->avcc = avr->aref = 5000;
+
+    for (k = 0; k < ADC_CHANNELS; k++)
+        adc[k] = avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + k);
+    go = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 2);
+    avr_raise_irq(go, 1);
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 3), 1);
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 4), 1);
+
+    span_init(&spans[0], "OSTickISR", "tick_isr");
+    span_init(&spans[1], "OSTimeTick", "ostimetick");
+    span_init(&spans[2], "OSCtxSw", "ctxsw");
+    span_init(&spans[3], "OSIntCtxSw", "int_ctxsw");
+    for (i = 0; i < NTASKS; i++)
+        if (!(stk[i] = sym_find(task_stacks[i], 1)))
+            fprintf(stderr, "avrbench: no %s in %s, its cycles count as other\n", task_stacks[i], elf);
+    navig_stk = sym_find("NavigStk", 1);
+    loop = sym_find(loop_sym, 0);
+    memset(task_cycles, 0, sizeof(task_cycles));
+    memset(&istk, 0, sizeof(istk));
+
+    end = (uint64_t)run_ms * CYCLES_PER_MS;
+    for (;;) {
+        uint64_t c0 = avr->cycle, ms = c0 / CYCLES_PER_MS;
+        uint32_t pc = avr->pc;
+        uint16_t op = avr->flash[pc] | (avr->flash[pc + 1] << 8);
+        uint16_t sp = avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+        int in_isr, in_ctxsw;
+        uint8_t tifr;
+
+        if (c0 >= end)
+            break;
+        // GO pressed from 100 to 200 ms; robo_wait4goPress waits for it
+        if (go_level != !(ms >= 100 && ms < 200)) {
+            go_level = !go_level;
+            avr_raise_irq(go, go_level);
+        }
+        while (w + 1 < nwave && wave[w + 1].ms <= ms) {
+            w++;
+            for (k = 0; k < ADC_CHANNELS; k++)
+                avr_raise_irq(adc[k], wave[w].adc[k] * 5000UL / 1023);
+        }
+
+        if (pc == vec_pc && flag_cycle) {
+            stat_add(&latency, c0 - flag_cycle);
+            flag_cycle = 0;
+        }
+        if (spans[0].hi && pc == spans[0].lo) {
+            if (last_tick)
+                stat_add(&period, c0 - last_tick);
+            last_tick = c0;
+        }
+        for (i = 0; i < 4; i++)
+            span_step(&spans[i], pc, op, c0);
+        if (pc > 0 && pc < VECTOR_COUNT * VECTOR_SIZE) {
+            if (istk.depth == 0) {
+                istk.base = sp + 2;     // the return address is pushed already
+                istk.low = sp;
+                istk.task = stack_of(sp);
+            }
+            if (++istk.depth > istk.max_depth)
+                istk.max_depth = istk.depth;
+        }
+        // OSIntCtxSw drops the depth count when it moves to another stack,
+        // but the ISR runs on until the OSTickISR span ends
+        in_isr = istk.depth != 0 || spans[0].active || spans[3].active;
+        in_ctxsw = spans[2].active != 0;
+        if (loop && pc == loop->addr && navig_stk && sp >= navig_stk->addr &&
+            sp < navig_stk->addr + navig_stk->size) {
+            if (navig_started)
+                stat_add(&navig, navig_acc);
+            navig_started = 1;
+            navig_acc = 0;
+        }
+
+        state = avr_run(avr);
+        if (state == cpu_Done || state == cpu_Crashed)
+            break;
+
+        for (i = 0; i < 4; i++)
+            if (span_after(&spans[i], avr->cycle) && i == 3 && spans[0].active) {
+                // OSIntCtxSw resumed a task that had yielded in OSCtxSw:
+                // that task does not go back through the ISR's reti
+                spans[0].active = 2;
+                span_after(&spans[0], avr->cycle);
+            }
+        tifr = avr->data[TIFR2_ADDR];
+        if ((tifr & OCF2A_BIT) && !(last_tifr & OCF2A_BIT) && !flag_cycle)
+            flag_cycle = avr->cycle;
+        last_tifr = tifr;
+
+        if (istk.depth) {
+            uint16_t nsp = avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+            if (stack_of(nsp) != istk.task) {
+                isr_stack_end(&istk);   // OSIntCtxSw switched tasks
+            } else {
+                if (nsp < istk.low)
+                    istk.low = nsp;
+                if (op == OP_RETI && --istk.depth == 0)
+                    isr_stack_end(&istk);
+            }
+        }
+
+        // Charge the instruction to the task whose stack was in use
+        i = stack_of(sp);
+        task_cycles[i] += avr->cycle - c0;
+        if (in_isr)
+            isr_depth_cycles += avr->cycle - c0;
+        else if (!in_ctxsw && navig_stk && i < NTASKS && stk[i] == navig_stk)
+            navig_acc += avr->cycle - c0;
+    }
+
+    if (out && !(f = fopen(out, "w"))) {
+        perror(out);
+        return 2;
+    }
+    fprintf(f, "{\n  \"elf\": \"%s\",\n  \"mcu\": \"atmega328p\",\n  \"f_cpu\": %lu,\n", elf, F_CPU);
+    fprintf(f, "  \"cycles\": %llu,\n  \"sim_ms\": %.1f,\n  \"waveform\": \"%s\",\n",
+            (unsigned long long)avr->cycle, (double)avr->cycle / CYCLES_PER_MS, wpath ? wpath : "builtin");
+    fprintf(f, "  \"metrics\": {\n");
+    print_stat(f, &latency, 0);
+    for (i = 0; i < 4; i++)
+        print_stat(f, &spans[i].st, 0);
+    print_stat(f, &period, 0);
+    print_stat(f, &navig, 1);
+    fprintf(f, "  },\n  \"isr_cycles\": %llu,\n  \"task_cycles\": {\n", (unsigned long long)isr_depth_cycles);
+    for (i = 0; i < NTASKS; i++)
+        fprintf(f, "    \"%s\": %llu,\n", task_stacks[i], (unsigned long long)task_cycles[i]);
+    fprintf(f, "    \"other\": %llu\n  },\n  \"isr_stack\": {\n", (unsigned long long)task_cycles[NTASKS]);
+    fprintf(f, "    \"max_depth\": %d,\n", istk.max_depth);
+    for (i = 0; i < NTASKS; i++)
+        fprintf(f, "    \"%s\": %u,\n", task_stacks[i], istk.max[i]);
+    fprintf(f, "    \"other\": %u\n  }\n}\n", istk.max[NTASKS]);
+    if (f != stdout)
+        fclose(f);
+    return 0;
+}
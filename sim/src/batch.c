@@ -0,0 +1,110 @@
+/*
+ *   BATCH.C -- Parallel evaluation of simulation runs in forked workers
+ *
+ *   Each run gets its own child process: the firmware keeps its state in
+ *   file-scope statics, and a fresh fork is the cheapest way to start every
+ *   run from power-on.  Results come back through a pipe; a result is far
+ *   smaller than PIPE_BUF so the child never blocks writing it.
+ */
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "batch.h"
+
+#define BATCH_MAX_WORKERS   64
+
+struct slot
+{
+    pid_t pid;
+    int   fd;
+    int   idx;
+};
+
+int batch_workers(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static int spawn(const struct run_config *cfg, int idx, struct slot *s)
+{
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+        return -1;
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        struct run_result r;
+        close(fds[0]);
+        if (sim_run(&cfg[idx], &r) < 0)
+            r.failed = 1;
+        if (write(fds[1], &r, sizeof(r)) != (ssize_t)sizeof(r))
+            _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    s->pid = pid;
+    s->fd = fds[0];
+    s->idx = idx;
+    return 0;
+}
+
+/* The child has exited, so its result is already sitting in the pipe */
+static void collect(struct slot *s, struct run_result *res)
+{
+    struct run_result *r = &res[s->idx];
+
+    if (read(s->fd, r, sizeof(*r)) != (ssize_t)sizeof(*r)) {
+        memset(r, 0, sizeof(*r));
+        r->failed = 1;
+    }
+    close(s->fd);
+    s->pid = 0;
+}
+
+/* Runs cfg[0..n-1] with at most `workers` processes alive; 0 on success */
+int batch_run(const struct run_config *cfg, struct run_result *res, int n, int workers)
+{
+    struct slot slots[BATCH_MAX_WORKERS];
+    int next = 0, running = 0, i;
+
+    if (workers < 1)
+        workers = batch_workers();
+    if (workers > BATCH_MAX_WORKERS)
+        workers = BATCH_MAX_WORKERS;
+    memset(slots, 0, sizeof(slots));
+
+    while (next < n || running > 0) {
+        for (i = 0; i < workers && next < n; i++) {
+            if (slots[i].pid)
+                continue;
+            if (spawn(cfg, next, &slots[i]) < 0)
+                return -1;
+            next++;
+            running++;
+        }
+        if (running > 0) {
+            int status;
+            pid_t pid = wait(&status);
+
+            if (pid < 0)
+                return -1;
+            for (i = 0; i < workers; i++) {
+                if (slots[i].pid == pid) {
+                    collect(&slots[i], res);
+                    running--;
+                    break;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+/*
+ *   BATCH.H -- Parallel evaluation of simulation runs in forked workers
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "simrun.h"
+
+int batch_workers(void);
+int batch_run(const struct run_config *cfg, struct run_result *res, int n, int workers);
+
+#endif
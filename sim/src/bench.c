@@ -0,0 +1,225 @@
+/*
+ *   BENCH.C -- Fixed scenario benchmark of robosample.c with a regression gate
+ *
+ *   Each scenario is a short track from tracks.c run over a few noise
+ *   seeds; the metrics are averaged over the seeds.  With -b the result is
+ *   compared against a stored baseline and the exit status is 1 if any
+ *   metric got worse by more than its tolerance.  -u writes the current
+ *   result as the new baseline instead.
+ *
+ *   usage: bench [-s seeds] [-j workers] [-b baseline] [-u] [NAME=value ...]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "batch.h"
+
+#define BENCH_MAX_TIME      60.0        // s; a scenario not completed costs this
+
+static const struct scenario
+{
+    const char *name;                   // track name in tracks.c
+    const char *desc;
+} scenarios[] = {
+    { "sprint",   "straight sprint" },
+    { "scurve",   "S-curves" },
+    { "lost",     "lost-line recovery" },
+    { "obstacle", "obstacle at speed" },
+    { "l2spur",   "L2 spur" },
+};
+#define NSCEN       (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+enum { M_TIME, M_RECOVERY, M_STOP, M_COLLIDE, M_CPU, NMETRICS };
+
+/* Every metric is "lower is better"; worse by more than max(abs, rel * base) fails */
+static const struct metric
+{
+    const char *name;
+    const char *unit;
+    double abs_tol, rel_tol;
+} metrics[NMETRICS] = {
+    { "time",       "s",   0.3,  0.05 },    // start to end of the line
+    { "recovery",   "s",   0.3,  0.10 },    // time with no sensor on the tape
+    { "stop",       "cm",  1.0,  0.10 },    // driven after the obstacle came in range
+    { "collisions", "",    0.0,  0.0  },
+    { "cpu",        "%",   2.0,  0.0  },
+};
+
+struct score
+{
+    double v[NMETRICS];
+    char   has[NMETRICS];
+};
+
+struct baseline
+{
+    char   scen[NSCEN * NMETRICS][16];
+    char   metric[NSCEN * NMETRICS][16];
+    double v[NSCEN * NMETRICS];
+    int    n;
+};
+
+static void summarize(const struct run_result *res, int seeds, struct score *sc)
+{
+    int s, m;
+
+    memset(sc, 0, sizeof(*sc));
+    for (m = 0; m < NMETRICS; m++)
+        sc->has[m] = m != M_STOP;
+    for (s = 0; s < seeds; s++) {
+        const struct run_result *r = &res[s];
+        sc->v[M_TIME] += (r->course_time > 0 ? r->course_time : BENCH_MAX_TIME) / seeds;
+        sc->v[M_RECOVERY] += r->lost_time / seeds;
+        sc->v[M_COLLIDE] += (double)r->collisions / seeds;
+        sc->v[M_CPU] += 100 * r->cpu_load / seeds;
+        if (r->stop_dist >= 0) {
+            sc->v[M_STOP] += r->stop_dist / seeds;
+            sc->has[M_STOP] = 1;
+        }
+    }
+}
+
+static int baseline_read(struct baseline *b, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[128];
+
+    memset(b, 0, sizeof(*b));
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f) && b->n < NSCEN * NMETRICS) {
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%15s %15s %lf", b->scen[b->n], b->metric[b->n], &b->v[b->n]) == 3)
+            b->n++;
+    }
+    fclose(f);
+    return 0;
+}
+
+static const double *baseline_find(const struct baseline *b, const char *scen, const char *metric)
+{
+    int i;
+
+    for (i = 0; i < b->n; i++)
+        if (strcmp(b->scen[i], scen) == 0 && strcmp(b->metric[i], metric) == 0)
+            return &b->v[i];
+    return 0;
+}
+
+static int baseline_write(const char *path, const struct score *sc, int seeds)
+{
+    FILE *f = fopen(path, "w");
+    int k, m;
+
+    if (!f)
+        return -1;
+    fprintf(f, "# bench baseline, %d seed(s) per scenario: scenario metric value\n", seeds);
+    for (k = 0; k < NSCEN; k++)
+        for (m = 0; m < NMETRICS; m++)
+            if (sc[k].has[m])
+                fprintf(f, "%-10s %-10s %.3f\n", scenarios[k].name, metrics[m].name, sc[k].v[m]);
+    fclose(f);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: bench [-s seeds] [-j workers] [-b baseline] [-u] [NAME=value ...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct run_config base, *cfg;
+    struct run_result *res;
+    struct score sc[NSCEN];
+    struct baseline bl;
+    const char *path = 0;
+    int seeds = 5, workers = 0, update = 0, have_bl = 0, regressions = 0;
+    int opt, i, k, m, n;
+
+    run_config_default(&base);
+    base.max_time = BENCH_MAX_TIME;
+    while ((opt = getopt(argc, argv, "s:j:b:u")) != -1) {
+        switch (opt)
+        {
+            case 's': seeds = atoi(optarg); break;
+            case 'j': workers = atoi(optarg); break;
+            case 'b': path = optarg; break;
+            case 'u': update = 1; break;
+            default: usage();
+        }
+    }
+    for (i = optind; i < argc; i++)
+        if (tune_parse(&base.tune, argv[i]) < 0)
+            usage();
+    if (seeds < 1 || (update && !path))
+        usage();
+
+    n = NSCEN * seeds;
+    cfg = calloc(n, sizeof(*cfg));
+    res = calloc(n, sizeof(*res));
+    if (!cfg || !res) {
+        perror("bench");
+        return 2;
+    }
+    for (k = 0; k < NSCEN; k++) {
+        for (i = 0; i < seeds; i++) {
+            cfg[k * seeds + i] = base;
+            snprintf(cfg[k * seeds + i].track, sizeof(cfg->track), "%s", scenarios[k].name);
+            cfg[k * seeds + i].prm.seed = base.prm.seed + i;
+        }
+    }
+    if (batch_run(cfg, res, n, workers) < 0) {
+        perror("bench");
+        return 2;
+    }
+    for (k = 0; k < NSCEN; k++)
+        summarize(&res[k * seeds], seeds, &sc[k]);
+
+    if (path && !update)
+        have_bl = baseline_read(&bl, path) == 0;
+    printf("%-10s %-20s %-10s %10s %10s\n", "scenario", "", "metric", "value", have_bl ? "baseline" : "");
+    for (k = 0; k < NSCEN; k++) {
+        for (m = 0; m < NMETRICS; m++) {
+            const double *b;
+            const char *verdict = "";
+            if (!sc[k].has[m])
+                continue;
+            printf("%-10s %-20s %-10s %7.2f %-2s", m == 0 ? scenarios[k].name : "",
+                   m == 0 ? scenarios[k].desc : "", metrics[m].name, sc[k].v[m], metrics[m].unit);
+            if (have_bl && (b = baseline_find(&bl, scenarios[k].name, metrics[m].name))) {
+                double tol = fmax(metrics[m].abs_tol, metrics[m].rel_tol * fabs(*b));
+                if (sc[k].v[m] > *b + tol + 1e-9) {
+                    verdict = "  REGRESSED";
+                    regressions++;
+                } else if (sc[k].v[m] < *b - tol - 1e-9) {
+                    verdict = "  improved";
+                }
+                printf(" %7.2f %-2s%s", *b, metrics[m].unit, verdict);
+            } else if (have_bl) {
+                printf("     new");
+            }
+            printf("\n");
+        }
+    }
+
+    if (update) {
+        if (baseline_write(path, sc, seeds) != 0) {
+            perror(path);
+            return 2;
+        }
+        printf("\nwrote %s\n", path);
+    } else if (path && !have_bl) {
+        printf("\nno baseline in %s (run with -u to create it)\n", path);
+    } else if (have_bl) {
+        printf("\n%d regression(s)\n", regressions);
+    }
+    free(cfg);
+    free(res);
+    return regressions != 0;
+}
@@ -0,0 +1,207 @@
+/*
+ *   CMAES.C -- Covariance Matrix Adaptation Evolution Strategy
+ *
+ *   Strategy parameters are the defaults from N. Hansen, "The CMA Evolution
+ *   Strategy: A Tutorial".  The covariance is decomposed with cyclic Jacobi
+ *   rotations, which is plenty for n <= CMA_MAX_N.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "cmaes.h"
+
+static double uniform(struct cmaes *c)
+{
+    unsigned long long z = (c->rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return ((z >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static double gauss(struct cmaes *c)
+{
+    return sqrt(-2.0 * log(uniform(c))) * cos(2.0 * M_PI * uniform(c));
+}
+
+/* Eigen-decomposition of the symmetric c->C into c->B (columns) and c->D */
+static void eigen(struct cmaes *c)
+{
+    double a[CMA_MAX_N][CMA_MAX_N];
+    int n = c->n, i, j, k, sweep;
+
+    memcpy(a, c->C, sizeof(a));
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            c->B[i][j] = i == j;
+
+    for (sweep = 0; sweep < 50; sweep++) {
+        double off = 0;
+        for (i = 0; i < n; i++)
+            for (j = i + 1; j < n; j++)
+                off += a[i][j] * a[i][j];
+        if (off < 1e-30)
+            break;
+
+        for (i = 0; i < n; i++) {
+            for (j = i + 1; j < n; j++) {
+                double th, t, cs, sn;
+                if (fabs(a[i][j]) < 1e-300)
+                    continue;
+                th = (a[j][j] - a[i][i]) / (2 * a[i][j]);
+                t = (th >= 0 ? 1 : -1) / (fabs(th) + sqrt(th * th + 1));
+                cs = 1 / sqrt(t * t + 1);
+                sn = t * cs;
+                for (k = 0; k < n; k++) {
+                    double aki = a[k][i], akj = a[k][j];
+                    a[k][i] = cs * aki - sn * akj;
+                    a[k][j] = sn * aki + cs * akj;
+                }
+                for (k = 0; k < n; k++) {
+                    double aik = a[i][k], ajk = a[j][k];
+                    a[i][k] = cs * aik - sn * ajk;
+                    a[j][k] = sn * aik + cs * ajk;
+                }
+                for (k = 0; k < n; k++) {
+                    double bki = c->B[k][i], bkj = c->B[k][j];
+                    c->B[k][i] = cs * bki - sn * bkj;
+                    c->B[k][j] = sn * bki + cs * bkj;
+                }
+            }
+        }
+    }
+    for (i = 0; i < n; i++)
+        c->D[i] = sqrt(a[i][i] > 1e-20 ? a[i][i] : 1e-20);
+}
+
+void cmaes_init(struct cmaes *c, int n, const double *x0, double sigma, int lambda, unsigned long long seed)
+{
+    double sw = 0, sw2 = 0;
+    int i;
+
+    memset(c, 0, sizeof(*c));
+    if (n > CMA_MAX_N)
+        n = CMA_MAX_N;
+    if (lambda <= 0)
+        lambda = 4 + (int)(3 * log((double)n));
+    if (lambda > CMA_MAX_LAMBDA)
+        lambda = CMA_MAX_LAMBDA;
+
+    c->n = n;
+    c->lambda = lambda;
+    c->mu = lambda / 2;
+    for (i = 0; i < c->mu; i++) {
+        c->w[i] = log(c->mu + 0.5) - log(i + 1.0);
+        sw += c->w[i];
+    }
+    for (i = 0; i < c->mu; i++) {
+        c->w[i] /= sw;
+        sw2 += c->w[i] * c->w[i];
+    }
+    c->mueff = 1 / sw2;
+
+    c->cc = (4 + c->mueff / n) / (n + 4 + 2 * c->mueff / n);
+    c->cs = (c->mueff + 2) / (n + c->mueff + 5);
+    c->c1 = 2 / ((n + 1.3) * (n + 1.3) + c->mueff);
+    c->cmu = 2 * (c->mueff - 2 + 1 / c->mueff) / ((n + 2) * (n + 2) + c->mueff);
+    if (c->cmu > 1 - c->c1)
+        c->cmu = 1 - c->c1;
+    c->damps = 1 + 2 * fmax(0, sqrt((c->mueff - 1) / (n + 1)) - 1) + c->cs;
+    c->chin = sqrt((double)n) * (1 - 1.0 / (4 * n) + 1.0 / (21.0 * n * n));
+
+    c->sigma = sigma;
+    memcpy(c->xmean, x0, n * sizeof(double));
+    for (i = 0; i < n; i++) {
+        c->C[i][i] = 1;
+        c->B[i][i] = 1;
+        c->D[i] = 1;
+    }
+    c->best_f = HUGE_VAL;
+    c->rng = seed;
+}
+
+void cmaes_ask(struct cmaes *c)
+{
+    double z[CMA_MAX_N];
+    int k, i, j;
+
+    for (k = 0; k < c->lambda; k++) {
+        for (i = 0; i < c->n; i++)
+            z[i] = c->D[i] * gauss(c);
+        for (i = 0; i < c->n; i++) {
+            double y = 0;
+            for (j = 0; j < c->n; j++)
+                y += c->B[i][j] * z[j];
+            c->arx[k][i] = c->xmean[i] + c->sigma * y;
+        }
+    }
+}
+
+void cmaes_tell(struct cmaes *c, const double *fit)
+{
+    int idx[CMA_MAX_LAMBDA];
+    double xold[CMA_MAX_N], yw[CMA_MAX_N], t[CMA_MAX_N], cinv_yw[CMA_MAX_N];
+    double psn = 0, hsig;
+    int n = c->n, i, j, k;
+
+    // Rank the offspring (insertion sort, lambda is small)
+    for (k = 0; k < c->lambda; k++) {
+        for (i = k; i > 0 && fit[idx[i - 1]] > fit[k]; i--)
+            idx[i] = idx[i - 1];
+        idx[i] = k;
+    }
+    if (fit[idx[0]] < c->best_f) {
+        c->best_f = fit[idx[0]];
+        memcpy(c->best_x, c->arx[idx[0]], n * sizeof(double));
+    }
+
+    memcpy(xold, c->xmean, n * sizeof(double));
+    for (i = 0; i < n; i++) {
+        c->xmean[i] = 0;
+        for (k = 0; k < c->mu; k++)
+            c->xmean[i] += c->w[k] * c->arx[idx[k]][i];
+        yw[i] = (c->xmean[i] - xold[i]) / c->sigma;
+    }
+
+    // C^-1/2 * yw = B * D^-1 * B' * yw
+    for (i = 0; i < n; i++) {
+        t[i] = 0;
+        for (j = 0; j < n; j++)
+            t[i] += c->B[j][i] * yw[j];
+        t[i] /= c->D[i];
+    }
+    for (i = 0; i < n; i++) {
+        cinv_yw[i] = 0;
+        for (j = 0; j < n; j++)
+            cinv_yw[i] += c->B[i][j] * t[j];
+    }
+
+    for (i = 0; i < n; i++) {
+        c->ps[i] = (1 - c->cs) * c->ps[i] + sqrt(c->cs * (2 - c->cs) * c->mueff) * cinv_yw[i];
+        psn += c->ps[i] * c->ps[i];
+    }
+    psn = sqrt(psn);
+    hsig = psn / sqrt(1 - pow(1 - c->cs, 2.0 * (c->gen + 1))) / c->chin < 1.4 + 2.0 / (n + 1);
+
+    for (i = 0; i < n; i++)
+        c->pc[i] = (1 - c->cc) * c->pc[i] + hsig * sqrt(c->cc * (2 - c->cc) * c->mueff) * yw[i];
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j <= i; j++) {
+            double rank_mu = 0, v;
+            for (k = 0; k < c->mu; k++) {
+                const double *x = c->arx[idx[k]];
+                rank_mu += c->w[k] * (x[i] - xold[i]) * (x[j] - xold[j]);
+            }
+            rank_mu /= c->sigma * c->sigma;
+            v = (1 - c->c1 - c->cmu) * c->C[i][j]
+              + c->c1 * (c->pc[i] * c->pc[j] + (1 - hsig) * c->cc * (2 - c->cc) * c->C[i][j])
+              + c->cmu * rank_mu;
+            c->C[i][j] = c->C[j][i] = v;
+        }
+    }
+
+    c->sigma *= exp((c->cs / c->damps) * (psn / c->chin - 1));
+    c->gen++;
+    eigen(c);
+}
@@ -0,0 +1,36 @@
+/*
+ *   CMAES.H -- Covariance Matrix Adaptation Evolution Strategy
+ *
+ *   Plain (mu/mu_w, lambda)-CMA-ES after Hansen's tutorial, sized for the
+ *   handful of controller constants we search.  Usage: cmaes_init once,
+ *   then repeatedly cmaes_ask, evaluate every row of arx, cmaes_tell.
+ */
+
+#ifndef CMAES_H
+#define CMAES_H
+
+#define CMA_MAX_N       16
+#define CMA_MAX_LAMBDA  64
+
+struct cmaes
+{
+    int n, lambda, mu, gen;
+    double w[CMA_MAX_LAMBDA];
+    double mueff, cc, cs, c1, cmu, damps, chin;
+    double sigma;
+    double xmean[CMA_MAX_N];
+    double pc[CMA_MAX_N], ps[CMA_MAX_N];
+    double C[CMA_MAX_N][CMA_MAX_N];
+    double B[CMA_MAX_N][CMA_MAX_N];
+    double D[CMA_MAX_N];
+    double arx[CMA_MAX_LAMBDA][CMA_MAX_N];
+    double best_x[CMA_MAX_N];
+    double best_f;
+    unsigned long long rng;
+};
+
+void cmaes_init(struct cmaes *c, int n, const double *x0, double sigma, int lambda, unsigned long long seed);
+void cmaes_ask(struct cmaes *c);
+void cmaes_tell(struct cmaes *c, const double *fit);
+
+#endif
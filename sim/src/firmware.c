@@ -0,0 +1,44 @@
+/*
+ *   FIRMWARE.C -- robosample.c built for the host
+ *
+ *   The target source is included directly so its file-scope state
+ *   (cp_state, seenL1, ...) can be read back, and the robotune.h constants
+ *   are turned into fields of sim_tune so they can be varied per run.
+ *   Keep the list below in step with TUNE_FIELDS in tune.h.
+ */
+
+#include "tune.h"
+#include "sim.h"
+
+#define ROBOTUNE_H
+#define STOP_SPEED       (sim_tune.v[TUNE_STOP_SPEED])
+#define VERY_LOW_SPEED   (sim_tune.v[TUNE_VERY_LOW_SPEED])
+#define LOW_SPEED        (sim_tune.v[TUNE_LOW_SPEED])
+#define MEDIUM_SPEED     (sim_tune.v[TUNE_MEDIUM_SPEED])
+#define HIGH_SPEED       (sim_tune.v[TUNE_HIGH_SPEED])
+#define REVERSE_SPEED    (sim_tune.v[TUNE_REVERSE_SPEED])
+#define TURN_GENTLE_PCT  (sim_tune.v[TUNE_TURN_GENTLE_PCT])
+#define TURN_SHARP_PCT   (sim_tune.v[TUNE_TURN_SHARP_PCT])
+#define LIGHT_ON_DELTA   (sim_tune.v[TUNE_LIGHT_ON_DELTA])
+#define LIGHT_OFF_DELTA  (sim_tune.v[TUNE_LIGHT_OFF_DELTA])
+#define SLEW_ACCEL       (sim_tune.v[TUNE_SLEW_ACCEL])
+#define SLEW_DECEL       (sim_tune.v[TUNE_SLEW_DECEL])
+
+#define main robo_main
+#include "../../robosample.c"
+#undef main
+
+int fw_main(void)
+{
+    return robo_main();
+}
+
+int fw_cp_state(void)
+{
+    return cp_state;
+}
+
+int fw_score(void)
+{
+    return myrobot.score;
+}
@@ -0,0 +1,180 @@
+/*
+ *   HAL_EXT_SIM.C -- Host stand-in for hal_ext.c
+ *
+ *   The millisecond clock follows virtual time; queued UART bytes go
+ *   straight to the sim_hal_uart() sink, costing only the transmit ISR.
+ *   The tick is the sim kernel's, exactly SIM_TICK_US apart, so
+ *   hal_tick_stats() reports no jitter.  Nothing is ever received.
+ *   hal_idle_sleep() sleeps to the next tick and counts that one wake;
+ *   the time asleep is the virtual time no CPU was charged for.
+ *   Each time the tick hook calls sim_hal_tick() the Timer2 interrupt's
+ *   work is done for a tick: wdog_isr() once a ms, drive_isr() and, once
+ *   started, a tick's worth of ADC conversions through adcscan_isr(); a
+ *   replay then sets the filter outputs to the recorded readings.
+ *   hal_motor_dir() sets the direction hal_sim.c applies.  There is no
+ *   reset to do, so a watchdog trip is only reported on stderr.
+ *   The EEPROM is sim_eeprom[]; simrun.c carries it from run to run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../../hal_ext.h"
+#include "../../adcscan.h"
+#include "../../wdog.h"
+#include "../../drive.h"
+#include "sim.h"
+
+#define CPU_UART_ISR_US     3.0
+#define CPU_EEPROM_BYTE_US  3400.0      // erase + write, busy-waited
+#define CPU_ADC_ISR_US      6.5         // ADC_vect + adcscan_isr, filter averaged in
+#define CPU_DRIVE_ISR_US    3.0         // drive_isr, wheels at their targets
+#define CPU_DRIVE_STEP_US   30.0        // and when it writes a new output
+#define SCAN_CONV_PER_TICK  (ADC_NCH * 10)  // a round of channels 0-5 every ms
+
+unsigned char sim_eeprom[SIM_EEPROM_SIZE];
+static char scanning;
+static INT32U tick_from, idle_from;
+static double idle_busy_us;
+static INT16U wakes;
+
+void hal_clock_init(void)
+{
+}
+
+INT32U hal_millis(void)
+{
+    return sim_now() * (1000 / OS_TICKS_PER_SEC);
+}
+
+void hal_tick_init(void)
+{
+    tick_from = sim_now();
+}
+
+void hal_tick_stats(struct hal_tick_stats *s)
+{
+    INT32U now = sim_now();
+
+    s->n = now - tick_from;
+    s->min = s->max = s->n ? SIM_TICK_US / HAL_TICK_UNIT_US : 0;
+    s->sum = (INT32U)s->n * (SIM_TICK_US / HAL_TICK_UNIT_US);
+    tick_from = now;
+}
+
+void hal_idle_sleep(void)
+{
+    OSTimeDly(1);
+    wakes++;
+}
+
+void hal_idle_stats(struct hal_idle_stats *s)
+{
+    INT32U now = sim_now();
+    double busy = sim_busy_us() - idle_busy_us;
+
+    s->span  = (now - idle_from) * (SIM_TICK_US / HAL_TICK_UNIT_US);
+    s->slept = busy < s->span * (double)HAL_TICK_UNIT_US
+             ? s->span - (INT32U)(busy / HAL_TICK_UNIT_US) : 0;
+    s->wakes = wakes;
+    idle_from = now;
+    idle_busy_us += busy;
+    wakes = 0;
+}
+
+INT32U hal_tick_millis(void)
+{
+    return hal_millis();
+}
+
+void hal_motor_dir(INT8U m, char rev)
+{
+    sim_hal_motor_dir(m, rev);
+}
+
+unsigned char hal_irq_save(void)
+{
+    return 0;
+}
+
+void hal_irq_restore(unsigned char sreg)
+{
+    (void)sreg;
+}
+
+void hal_adc_scan_start(void)
+{
+    scanning = 1;
+}
+
+void hal_wdt_start(void)
+{
+}
+
+void hal_wdt_kick(void)
+{
+}
+
+void hal_wdt_trip(INT8U who)
+{
+    fprintf(stderr, "watchdog: task %d missed its deadline at %lu ms\n", who, (unsigned long)hal_millis());
+}
+
+INT8U hal_wdt_culprit(void)
+{
+    return HAL_WDT_NONE;
+}
+
+void sim_hal_tick(void)
+{
+    int i, l, r;
+
+    for (i = 0; i < HAL_TICK_MS; i++)
+        wdog_isr();
+    l = drive_left();
+    r = drive_right();
+    drive_isr();
+    sim_cpu(l == drive_left() && r == drive_right() ? CPU_DRIVE_ISR_US : CPU_DRIVE_STEP_US);
+    if (!scanning)
+        return;
+    for (i = 0; i < SCAN_CONV_PER_TICK; i++) {
+        sim_cpu(CPU_ADC_ISR_US);
+        adcscan_isr(i % ADC_NCH, sim_hal_adc(i % ADC_NCH));
+    }
+    sim_hal_replay_scan();
+}
+
+void hal_uart_init(unsigned int ubrr)
+{
+    (void)ubrr;
+}
+
+char hal_uart_write(const char *buf, unsigned char len)
+{
+    while (len--) {
+        sim_cpu_isr(CPU_UART_ISR_US);
+        sim_hal_uart_put(*buf++);
+    }
+    return 1;
+}
+
+int hal_uart_read(void)
+{
+    return -1;
+}
+
+void hal_eeprom_read(INT16U addr, void *buf, INT16U len)
+{
+    memcpy(buf, &sim_eeprom[addr], len);
+}
+
+void hal_eeprom_write(INT16U addr, const void *buf, INT16U len)
+{
+    const unsigned char *p = buf;
+
+    for (; len--; addr++, p++) {
+        if (sim_eeprom[addr] != *p) {
+            sim_cpu(CPU_EEPROM_BYTE_US);
+            sim_eeprom[addr] = *p;
+        }
+    }
+}
@@ -0,0 +1,299 @@
+/*
+ *   HAL_SIM.C -- Host stand-in for hal_robo.o
+ *
+ *   Sensor functions do the same arithmetic as the target HAL on raw ADC
+ *   counts from the world model.  CPU costs follow the target listing:
+ *   a conversion is ~13 ADC clocks at 125 kHz, motor_set_dir busy-waits
+ *   10 ms (1 ms more on a direction change) and robo_Honk 2 x 300 ms.
+ *
+ *   sim_hal_sensors() replaces the world model behind the line, light and
+ *   proximity sensors, e.g. with a recorded run (replay.c).
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "../inc/hal_robo.h"
+#include "../../adcscan.h"
+#include "sim.h"
+
+#define CPU_ADC_US          112.0
+#define CPU_DIV_US          15.0        // __divmodhi4 in robo_lightSensor
+#define CPU_DIR_US          10000.0
+#define CPU_DIR_CHANGE_US   1000.0
+#define CPU_HONK_US         600000.0
+#define CPU_UART_CHAR_US    1042.0      // 10 bits at 9600 baud
+#define REPLAY_NEAR_ADC     40          // prox, obstacle in range
+#define REPLAY_FAR_ADC      600
+
+struct world sim_world;
+
+static char motor_dir[2];               // [0] right, [1] left; 1 = reverse
+static int  motor_pwm[2];
+static sim_uart_fn uart_fn;
+static void *uart_arg;
+static sim_sensor_fn sensor_fn;
+static void *sensor_arg;
+static int  verbose;
+static char go_held;
+
+void sim_hal_reset(void)
+{
+    motor_dir[0] = motor_dir[1] = 0;
+    motor_pwm[0] = motor_pwm[1] = 0;
+    uart_fn = 0;
+    uart_arg = 0;
+    sensor_fn = 0;
+    sensor_arg = 0;
+    go_held = 0;
+}
+
+void sim_hal_uart(sim_uart_fn fn, void *arg)
+{
+    uart_fn = fn;
+    uart_arg = arg;
+}
+
+void sim_hal_sensors(sim_sensor_fn fn, void *arg)
+{
+    sensor_fn = fn;
+    sensor_arg = arg;
+}
+
+void sim_hal_verbose(int on)
+{
+    verbose = on;
+}
+
+static void apply_motors(void)
+{
+    sim_world.bot.pwm_r = motor_dir[0] ? -motor_pwm[0] : motor_pwm[0];
+    sim_world.bot.pwm_l = motor_dir[1] ? -motor_pwm[1] : motor_pwm[1];
+}
+
+void robo_Setup(void)
+{
+    HAL_init();
+    motor_init();
+}
+
+void HAL_init(void)
+{
+    USART0_init(103);
+}
+
+void OS_ticks_init(void)
+{
+}
+
+void USART0_init(unsigned int ubrr)
+{
+    (void)ubrr;
+}
+
+/* One conversion at no CPU cost; ADC_read() and the scan in hal_ext_sim.c
+   charge for it.  While replaying, the line channels read as recorded and
+   prox as near or far after the replayed value; the scan converts left
+   first, which fetches the next line record */
+unsigned int sim_hal_adc(unsigned char channel)
+{
+    if (sensor_fn && channel >= ADC_CH_LINE_L && channel <= ADC_CH_LINE_R)
+        return sensor_fn(SIM_SENSOR_LINE_L + (channel - ADC_CH_LINE_L), sensor_arg);
+    if (sensor_fn && channel == ADC_CH_LIGHT)
+        return sensor_fn(SIM_SENSOR_LIGHT, sensor_arg);
+    if (sensor_fn && channel == ADC_CH_PROX)
+        return sensor_fn(SIM_SENSOR_PROX, sensor_arg) ? REPLAY_NEAR_ADC : REPLAY_FAR_ADC;
+    return world_adc(&sim_world, channel);
+}
+
+/* The log holds what the firmware read behind its adcscan filters, so while
+   replaying those outputs are set as recorded rather than filtered again */
+void sim_hal_replay_scan(void)
+{
+    unsigned char ch;
+
+    if (!sensor_fn)
+        return;
+    for (ch = ADC_CH_LINE_L; ch <= ADC_CH_LINE_R; ch++)
+        adcscan_set(ch, sim_hal_adc(ch));
+    adcscan_set(ADC_CH_LIGHT, sensor_fn(SIM_SENSOR_LIGHT, sensor_arg));
+    adcscan_set(ADC_CH_PROX, sim_hal_adc(ADC_CH_PROX));
+}
+
+unsigned int ADC_read(unsigned char channel)
+{
+    sim_cpu(CPU_ADC_US);
+    return sim_hal_adc(channel);
+}
+
+void motor_init(void)
+{
+    motor_pwm[0] = motor_pwm[1] = 0;
+    apply_motors();
+}
+
+void motor_set_speed(char motor, int speed)
+{
+    if (speed < 0)
+        speed = 0;
+    if (speed > 100)
+        speed = 100;
+    motor_pwm[motor ? 1 : 0] = speed * 2 + speed / 2;
+    apply_motors();
+}
+
+void motor_set_dir(char motor, char dir)
+{
+    int m = motor ? 1 : 0;
+
+    if (motor_dir[m] != dir) {
+        motor_set_speed(motor, 0);
+        sim_cpu(CPU_DIR_CHANGE_US);
+    }
+    motor_dir[m] = dir ? 1 : 0;
+    apply_motors();
+    sim_cpu(CPU_DIR_US);
+}
+
+void sim_hal_motor_dir(char motor, char dir)
+{
+    motor_dir[motor ? 1 : 0] = dir ? 1 : 0;
+    apply_motors();
+}
+
+void robo_motorSpeed(int lspeed, int rspeed)
+{
+    if (lspeed < 0) {
+        motor_set_dir(1, 1);
+        lspeed = -lspeed;
+    } else {
+        motor_set_dir(1, 0);
+    }
+    if (rspeed < 0) {
+        motor_set_dir(0, 1);
+        rspeed = -rspeed;
+    } else {
+        motor_set_dir(0, 0);
+    }
+    motor_set_speed(0, rspeed);
+    motor_set_speed(1, lspeed);
+}
+
+int robo_proxSensor(void)
+{
+    if (sensor_fn) {
+        sim_cpu(CPU_ADC_US);
+        return sensor_fn(SIM_SENSOR_PROX, sensor_arg);
+    }
+    return ADC_read(ADC_CH_PROX) < 100;
+}
+
+int robo_lightSensor(void)
+{
+    int v = (5115 - 5 * (int)ADC_read(ADC_CH_LIGHT)) / 51;
+
+    sim_cpu(CPU_DIV_US);
+    return v > 100 ? 100 : v;
+}
+
+int robo_lineSensor(void)
+{
+    int code = 0;
+    unsigned char ch;
+
+    for (ch = ADC_CH_LINE_L; ch <= ADC_CH_LINE_R; ch++) {
+        code <<= 1;
+        if ((int)ADC_read(ch) < 300)
+            code |= 1;
+    }
+    return code;
+}
+
+int robo_bumpSensorR(void)
+{
+    return world_bump(&sim_world, 1);
+}
+
+int robo_bumpSensorL(void)
+{
+    return world_bump(&sim_world, 0);
+}
+
+void robo_checkBattery(void)
+{
+    ADC_read(ADC_CH_BATT);
+}
+
+char robo_goPressed(void)
+{
+    return go_held;
+}
+
+void sim_hal_go(int held)
+{
+    go_held = held != 0;
+}
+
+void robo_wait4goPress(void)
+{
+}
+
+void robo_Honk(void)
+{
+    sim_world.honks++;
+    sim_cpu(CPU_HONK_US);
+}
+
+void robo_LED_on(void)
+{
+    sim_world.led = 1;
+}
+
+void robo_LED_off(void)
+{
+    sim_world.led = 0;
+}
+
+void robo_LED_toggle(void)
+{
+    sim_world.led = !sim_world.led;
+}
+
+/* Byte leaving the UART without the busy-wait (hal_ext_sim.c) */
+void sim_hal_uart_put(char c)
+{
+    if (uart_fn)
+        uart_fn(c, uart_arg);
+    if (verbose)
+        fputc(c, stderr);
+}
+
+void cputchar(char c)
+{
+    sim_cpu(CPU_UART_CHAR_US);
+    if (uart_fn)
+        uart_fn(c, uart_arg);
+    if (verbose)
+        fputc(c, stderr);
+}
+
+char cgetchar(void)
+{
+    return 0;
+}
+
+void cputs(const char *s)
+{
+    while (*s)
+        cputchar(*s++);
+}
+
+void cprintf(const char *fmt, ...)
+{
+    char buf[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    cputs(buf);
+}
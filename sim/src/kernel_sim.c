@@ -0,0 +1,231 @@
+/*
+ *   KERNEL_SIM.C -- Virtual-time stand-in for the uC/OS-II kernel
+ *
+ *   Every task gets a host stack and a ucontext.  Virtual time advances one
+ *   OS tick at a time; on each tick the ready tasks run in priority order
+ *   until they block in OSTimeDly, then the tick hook steps the world.
+ *
+ *   Task code itself takes no virtual time.  Blocking HAL calls (the 10 ms
+ *   busy-wait in motor_set_dir, the UART, robo_Honk) charge CPU time through
+ *   sim_cpu(); at the next delay the whole ticks of that debt are spent
+ *   holding the CPU, which starves lower priority tasks the way the
+ *   busy-waits do on the target.
+ */
+
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "sim.h"
+
+#define TASK_HOST_STACK     (64 * 1024)
+#define TICK_ISR_US         25.0        // OSTickISR + OSTimeTick for four tasks
+#define HMSM_US             45.0        // OSTimeDlyHMSM: 32-bit multiplies and __udivmodsi4
+
+struct sim_tcb
+{
+    void (*fn)(void *pd);
+    void *arg;
+    ucontext_t ctx;
+    char *stk;
+    INT32U wake;                // tick at which the current delay ends
+    INT32U busy_until;          // task keeps the CPU until this tick
+    double debt_us;             // CPU charged since the last delay
+    struct sim_task_stats st;
+};
+
+volatile INT8U  OSRunning;
+volatile INT32U OSIdleCtr;
+volatile INT32U OSCtxSwCtr;
+
+static struct sim_tcb tcb[OS_LOWEST_PRIO + 1];
+static ucontext_t sched_ctx;
+static jmp_buf    exit_jmp;
+static INT32U     now;
+static int        cur = -1;
+static double     busy_us;
+static sim_tick_fn tick_hook;
+static void      *tick_arg;
+
+void sim_kernel_reset(sim_tick_fn hook, void *arg)
+{
+    int p;
+
+    for (p = 0; p <= OS_LOWEST_PRIO; p++)
+        free(tcb[p].stk);
+    memset(tcb, 0, sizeof(tcb));
+    now = 0;
+    cur = -1;
+    busy_us = 0;
+    OSRunning = 0;
+    OSIdleCtr = 0;
+    OSCtxSwCtr = 0;
+    tick_hook = hook;
+    tick_arg = arg;
+}
+
+void sim_cpu(double us)
+{
+    busy_us += us;
+    if (cur >= 0) {
+        tcb[cur].debt_us += us;
+        tcb[cur].st.cpu_us += us;
+    }
+}
+
+void sim_cpu_isr(double us)
+{
+    busy_us += us;
+}
+
+INT32U sim_now(void)
+{
+    return now;
+}
+
+double sim_cpu_load(void)
+{
+    return now ? busy_us / ((double)now * SIM_TICK_US) : 0;
+}
+
+double sim_busy_us(void)
+{
+    return busy_us;
+}
+
+const struct sim_task_stats *sim_task(INT8U prio)
+{
+    return prio <= OS_LOWEST_PRIO ? &tcb[prio].st : 0;
+}
+
+/* Runs the firmware's main(); returns once a tick hook ends the run */
+int sim_kernel_run(int (*entry)(void))
+{
+    if (setjmp(exit_jmp) == 0) {
+        entry();
+        return -1;              // main() returned without starting the kernel
+    }
+    return 0;
+}
+
+void OSInit(void)
+{
+    OSRunning = 0;
+}
+
+static void task_entry(void)
+{
+    struct sim_tcb *t = &tcb[cur];
+
+    t->fn(t->arg);
+    t->st.used = 0;             // uC/OS-II tasks must never return; treat it as deleted
+}
+
+INT8U OSTaskCreate(void (*task)(void *pd), void *pdata, OS_STK *ptos, INT8U prio)
+{
+    struct sim_tcb *t;
+
+    (void)ptos;                 // target stack is far too small for host code
+    if (prio > OS_LOWEST_PRIO)
+        return OS_PRIO_INVALID;
+    t = &tcb[prio];
+    if (t->st.used)
+        return OS_PRIO_EXIST;
+
+    t->fn = task;
+    t->arg = pdata;
+    if (!t->stk)
+        t->stk = malloc(TASK_HOST_STACK);
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->stk;
+    t->ctx.uc_stack.ss_size = TASK_HOST_STACK;
+    t->ctx.uc_link = &sched_ctx;
+    makecontext(&t->ctx, task_entry, 0);
+    t->wake = now;
+    t->busy_until = now;
+    t->debt_us = 0;
+    t->st.used = 1;
+    return OS_NO_ERR;
+}
+
+void OSTimeDly(INT16U ticks)
+{
+    struct sim_tcb *t;
+    INT32U held;
+
+    if (ticks == 0 || cur < 0)
+        return;
+    t = &tcb[cur];
+    held = (INT32U)(t->debt_us / SIM_TICK_US);
+    t->debt_us -= held * (double)SIM_TICK_US;
+    t->busy_until = now + held;
+    t->wake = now + held + ticks;
+    swapcontext(&t->ctx, &sched_ctx);
+}
+
+INT8U OSTimeDlyHMSM(INT8U hours, INT8U minutes, INT8U seconds, INT16U milli)
+{
+    INT32U ticks;
+
+    sim_cpu(HMSM_US);
+    if (hours == 0 && minutes == 0 && seconds == 0 && milli == 0)
+        return OS_TIME_ZERO_DLY;
+    if (minutes > 59)
+        return OS_TIME_INVALID_MINUTES;
+    if (seconds > 59)
+        return OS_TIME_INVALID_SECONDS;
+    if (milli > 999)
+        return OS_TIME_INVALID_MILLI;
+
+    // Same rounding as the target: ms are rounded to the nearest tick
+    ticks = ((INT32U)hours * 3600UL + (INT32U)minutes * 60UL + seconds) * OS_TICKS_PER_SEC
+          + (OS_TICKS_PER_SEC * ((INT32U)milli + 500UL / OS_TICKS_PER_SEC)) / 1000UL;
+    while (ticks > 65535UL) {
+        OSTimeDly(32768);
+        ticks -= 32768;
+    }
+    OSTimeDly((INT16U)ticks);
+    return OS_NO_ERR;
+}
+
+void OSTimeTick(void)
+{
+    busy_us += TICK_ISR_US;
+    now++;
+}
+
+void OSStart(void)
+{
+    int p;
+
+    OSRunning = 1;
+    for (;;) {
+        char ran = 0;
+
+        for (p = 0; p <= OS_LOWEST_PRIO; p++) {
+            struct sim_tcb *t = &tcb[p];
+
+            if (!t->st.used)
+                continue;
+            if (t->busy_until > now)
+                break;          // still inside a busy-wait; nothing below runs
+            if (t->wake > now)
+                continue;
+
+            cur = p;
+            t->st.runs++;
+            OSCtxSwCtr++;
+            ran = 1;
+            swapcontext(&sched_ctx, &t->ctx);
+            cur = -1;
+            if (t->st.used && t->busy_until > now)
+                break;
+        }
+        if (!ran)
+            OSIdleCtr++;
+
+        OSTimeTick();
+        if (tick_hook && tick_hook(tick_arg))
+            longjmp(exit_jmp, 1);
+    }
+}
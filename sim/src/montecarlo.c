@@ -0,0 +1,295 @@
+/*
+ *   MONTECARLO.C -- Robustness of robosample.c over randomised courses
+ *
+ *   Every sample draws the world parameters uniformly from the ranges in
+ *   perturb[] (ADC noise, line contrast, ambient light, motor asymmetry,
+ *   battery and obstacle timing) and runs the firmware once.  The report
+ *   gives, for each checkpoint, how often the robot got there and how often
+ *   the firmware counted that bar on time, then the lap-time distribution
+ *   of the runs that finished: the firmware reached CP_DONE with the robot
+ *   across every bar, not by counting some twice.  Samples run as one
+ *   parallel batch.
+ *
+ *   usage: montecarlo [-t track] [-n samples] [-s seed] [-j workers]
+ *                     [-o samples.csv] [name=lo:hi | name=value ...]
+ *                     [NAME=value ...]
+ *
+ *   Lower-case names set a perturbation range (a single value pins it),
+ *   upper-case names override a robotune.h constant.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "batch.h"
+
+#define CP_EARLY        0.3         // s a count may precede the bar crossing
+#define CP_LATE         1.0         // s a count may follow it
+#define HIST_BINS       12
+#define HIST_WIDTH      50
+
+static struct perturb
+{
+    const char *name;
+    size_t off;                     // field of struct world_params
+    double lo, hi;
+    const char *desc;
+} perturb[] = {
+#define P(name, field, lo, hi, desc) { name, offsetof(struct world_params, field), lo, hi, desc }
+    P("noise",   adc_noise,       2,   25,  "ADC noise, counts rms"),
+    P("floor",   floor_adc,     550,  850,  "line-sensor ADC over the floor"),
+    P("line",    line_adc,       60,  280,  "line-sensor ADC over the line"),
+    P("ambient", ambient,         0,   75,  "ambient light, robo_lightSensor units"),
+    P("lamp",    lamp_gain,     0.6,  1.4,  "lamp intensity scale"),
+    P("gain_l",  gain_l,       0.85, 1.15,  "left motor gain"),
+    P("gain_r",  gain_r,       0.85, 1.15,  "right motor gain"),
+    P("vbat",    vbat,          6.6,  8.2,  "battery at start, V"),
+    P("sag",     vbat_sag,        0, 0.15,  "battery sag, V/min"),
+    P("hold",    obstacle_hold, 0.5,  8.0,  "obstacle dwell, s"),
+#undef P
+};
+#define NPERTURB    (int)(sizeof(perturb) / sizeof(perturb[0]))
+
+static double *field(struct world_params *prm, int i)
+{
+    return (double *)((char *)prm + perturb[i].off);
+}
+
+static int perturb_parse(const char *assign)
+{
+    const char *eq = strchr(assign, '=');
+    double lo, hi;
+    int i;
+
+    if (!eq)
+        return -1;
+    for (i = 0; i < NPERTURB; i++) {
+        if (strlen(perturb[i].name) == (size_t)(eq - assign) &&
+            strncmp(perturb[i].name, assign, eq - assign) == 0)
+            break;
+    }
+    if (i == NPERTURB)
+        return -1;
+    switch (sscanf(eq + 1, "%lf:%lf", &lo, &hi))
+    {
+        case 1: hi = lo; break;
+        case 2: break;
+        default: return -1;
+    }
+    perturb[i].lo = lo < hi ? lo : hi;
+    perturb[i].hi = lo < hi ? hi : lo;
+    return 0;
+}
+
+/* splitmix64; independent of the per-run noise stream in world.c */
+static double uniform(unsigned long long *s)
+{
+    unsigned long long z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Checkpoint k is the firmware entering cp_state k, due at bar k-1 */
+static int cp_reached(const struct run_result *r, int k)
+{
+    return k - 1 < r->bars_passed;
+}
+
+static int cp_on_time(const struct run_result *r, int k)
+{
+    double dt;
+
+    if (!cp_reached(r, k) || r->checkpoints < k)
+        return 0;
+    dt = r->cp_time[k] - r->bar_time[k - 1];
+    return dt >= -CP_EARLY && dt <= CP_LATE;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double quantile(const double *v, int n, double q)
+{
+    double pos = q * (n - 1);
+    int i = (int)pos;
+
+    if (i + 1 >= n)
+        return v[n - 1];
+    return v[i] + (pos - i) * (v[i + 1] - v[i]);
+}
+
+static void report_checkpoints(const struct run_result *res, int n, int nbars)
+{
+    static const char *names[] = { "START", "A", "B", "C", "D", "E", "F", "DONE" };
+    int k, i;
+
+    printf("\ncheckpoint  bar  reached  counted on time\n");
+    for (k = 1; k <= RUN_CP_DONE && k <= nbars; k++) {
+        int reached = 0, on_time = 0;
+        for (i = 0; i < n; i++) {
+            reached += cp_reached(&res[i], k);
+            on_time += cp_on_time(&res[i], k);
+        }
+        printf("CP_%-8s %3d  %6.1f%%  %6.1f%%\n", names[k], k - 1,
+               100.0 * reached / n, 100.0 * on_time / n);
+    }
+}
+
+static void report_laps(const struct run_result *res, int n)
+{
+    double *lap = malloc(n * sizeof(*lap)), mean = 0, sd = 0, lo, w;
+    int hist[HIST_BINS] = { 0 }, m = 0, peak = 1, i, b;
+
+    if (!lap)
+        return;
+    for (i = 0; i < n; i++)
+        if (res[i].finished)
+            lap[m++] = res[i].lap_time;
+    printf("\nlap time    %d of %d finished (%.1f%%)\n", m, n, 100.0 * m / n);
+    if (m == 0) {
+        free(lap);
+        return;
+    }
+    qsort(lap, m, sizeof(*lap), cmp_double);
+    for (i = 0; i < m; i++)
+        mean += lap[i] / m;
+    for (i = 0; i < m; i++)
+        sd += (lap[i] - mean) * (lap[i] - mean) / m;
+    printf("            min %.2f  p10 %.2f  median %.2f  p90 %.2f  max %.2f s\n",
+           lap[0], quantile(lap, m, 0.1), quantile(lap, m, 0.5), quantile(lap, m, 0.9), lap[m - 1]);
+    printf("            mean %.2f s, sd %.2f s\n\n", mean, sqrt(sd));
+
+    lo = lap[0];
+    w = (lap[m - 1] - lo) / HIST_BINS;
+    if (w <= 0)
+        w = 1;
+    for (i = 0; i < m; i++) {
+        b = (int)((lap[i] - lo) / w);
+        hist[b < HIST_BINS ? b : HIST_BINS - 1]++;
+    }
+    for (b = 0; b < HIST_BINS; b++)
+        if (hist[b] > peak)
+            peak = hist[b];
+    for (b = 0; b < HIST_BINS; b++)
+        printf("  %6.2f %6d |%.*s\n", lo + b * w, hist[b],
+               (hist[b] * HIST_WIDTH + peak - 1) / peak,
+               "##################################################");
+    free(lap);
+}
+
+static int write_samples(const char *path, const struct run_config *cfg,
+                         const struct run_result *res, int n)
+{
+    FILE *f = fopen(path, "w");
+    int i, k;
+
+    if (!f)
+        return -1;
+    fprintf(f, "seed");
+    for (k = 0; k < NPERTURB; k++)
+        fprintf(f, ",%s", perturb[k].name);
+    fprintf(f, ",finished,lap_time,progress,bars_passed,checkpoints,line_losses,collisions\n");
+    for (i = 0; i < n; i++) {
+        struct world_params prm = cfg[i].prm;
+        fprintf(f, "%llu", prm.seed);
+        for (k = 0; k < NPERTURB; k++)
+            fprintf(f, ",%.4g", *field(&prm, k));
+        fprintf(f, ",%d,%.2f,%.3f,%d,%d,%d,%d\n", res[i].finished, res[i].lap_time,
+                res[i].progress, res[i].bars_passed, res[i].checkpoints,
+                res[i].line_losses, res[i].collisions);
+    }
+    fclose(f);
+    return 0;
+}
+
+static void usage(void)
+{
+    int i;
+
+    fprintf(stderr, "usage: montecarlo [-t track] [-n samples] [-s seed] [-j workers]\n"
+                    "                  [-o samples.csv] [name=lo:hi | name=value ...]\n"
+                    "                  [NAME=value ...]\nperturbations:\n");
+    for (i = 0; i < NPERTURB; i++)
+        fprintf(stderr, "  %-8s %7.3g .. %-7.3g %s\n", perturb[i].name,
+                perturb[i].lo, perturb[i].hi, perturb[i].desc);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct run_config base, *cfg;
+    struct run_result *res;
+    const char *out = 0;
+    unsigned long long seed = 1, rng;
+    int n = 1000, workers = 0, failed = 0, nbars = 0;
+    int opt, i, k;
+
+    run_config_default(&base);
+    while ((opt = getopt(argc, argv, "t:n:s:j:o:")) != -1) {
+        switch (opt)
+        {
+            case 't': snprintf(base.track, sizeof(base.track), "%s", optarg); break;
+            case 'n': n = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, 0, 0); break;
+            case 'j': workers = atoi(optarg); break;
+            case 'o': out = optarg; break;
+            default: usage();
+        }
+    }
+    for (i = optind; i < argc; i++)
+        if (perturb_parse(argv[i]) < 0 && tune_parse(&base.tune, argv[i]) < 0)
+            usage();
+    if (n < 1)
+        usage();
+
+    cfg = calloc(n, sizeof(*cfg));
+    res = calloc(n, sizeof(*res));
+    if (!cfg || !res) {
+        perror("montecarlo");
+        return 1;
+    }
+    rng = seed;
+    for (i = 0; i < n; i++) {
+        cfg[i] = base;
+        for (k = 0; k < NPERTURB; k++)
+            *field(&cfg[i].prm, k) = perturb[k].lo + uniform(&rng) * (perturb[k].hi - perturb[k].lo);
+        cfg[i].prm.seed = seed + i;
+    }
+    if (batch_run(cfg, res, n, workers) < 0) {
+        perror("montecarlo");
+        return 1;
+    }
+    for (i = 0; i < n; i++) {
+        failed += res[i].failed;
+        if (res[i].bars > nbars)
+            nbars = res[i].bars;
+    }
+    if (failed == n) {
+        fprintf(stderr, "montecarlo: unknown track '%s'\n", base.track);
+        usage();
+    }
+
+    printf("track       %s, %d samples from seed %llu\n", base.track, n, seed);
+    for (k = 0; k < NPERTURB; k++)
+        printf("  %-8s %7.3g .. %-7.3g %s\n", perturb[k].name, perturb[k].lo, perturb[k].hi, perturb[k].desc);
+    if (failed)
+        printf("%d worker(s) failed\n", failed);
+    report_checkpoints(res, n, nbars);
+    report_laps(res, n);
+
+    if (out && write_samples(out, cfg, res, n) != 0) {
+        perror(out);
+        return 1;
+    }
+    free(cfg);
+    free(res);
+    return 0;
+}
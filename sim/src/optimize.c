@@ -0,0 +1,213 @@
+/*
+ *   OPTIMIZE.C -- Black-box tuning of robotune.h with CMA-ES
+ *
+ *   Every candidate is a full closed-loop run of robosample.c over the
+ *   simulated course, repeated over a few noise seeds.  The objective is lap
+ *   time plus penalties for line losses, miscounted checkpoints and
+ *   collisions; a run that never finishes costs the time limit plus the
+ *   unfinished part of the course.  Each generation is evaluated as one
+ *   parallel batch.  The best set found is written as a robotune.h header.
+ *
+ *   usage: optimize [-t track] [-g generations] [-s seeds] [-l lambda]
+ *                   [-j workers] [-o robotune.h] [NAME=value ...]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "batch.h"
+#include "cmaes.h"
+
+#define W_LINE_LOSS     2.0         // s per line loss
+#define W_CHECKPOINT   20.0         // s per bar missed or counted twice
+#define W_COLLISION    30.0         // s per collision
+#define W_OUT_OF_RANGE 100.0        // per unit^2 outside the search box
+
+static int dims[TUNE_COUNT];        // search dimension -> tune index
+static int ndims;
+
+static double run_cost(const struct run_result *r, double max_time)
+{
+    double cost;
+
+    if (r->failed)
+        return 10 * max_time;
+    cost = r->finished ? r->lap_time : max_time + (1 - r->progress) * max_time;
+    cost += W_LINE_LOSS * r->line_losses;
+    cost += W_CHECKPOINT * abs(r->bars_passed - r->checkpoints);
+    cost += W_COLLISION * r->collisions;
+    return cost;
+}
+
+/* Search space is the unit box; x outside it is clamped and penalised, and
+ * so is a point tune_constrain() has to move */
+static double decode(const double *x, const struct tune *base, struct tune *t)
+{
+    const struct tune_info *off = &tune_info[TUNE_LIGHT_OFF_DELTA];
+    double pen = 0, moved;
+    int d;
+
+    *t = *base;
+    for (d = 0; d < ndims; d++) {
+        const struct tune_info *ti = &tune_info[dims[d]];
+        double u = x[d];
+        if (u < 0) {
+            pen += u * u;
+            u = 0;
+        } else if (u > 1) {
+            pen += (u - 1) * (u - 1);
+            u = 1;
+        }
+        t->v[dims[d]] = (int)lround(ti->lo + u * (ti->hi - ti->lo));
+    }
+    moved = (double)tune_constrain(t) / (off->hi > off->lo ? off->hi - off->lo : 1);
+    return W_OUT_OF_RANGE * (pen + moved * moved);
+}
+
+static void encode(const struct tune *t, double *x)
+{
+    int d;
+
+    for (d = 0; d < ndims; d++) {
+        const struct tune_info *ti = &tune_info[dims[d]];
+        x[d] = (double)(t->v[dims[d]] - ti->lo) / (ti->hi - ti->lo);
+    }
+}
+
+/* Mean cost of each candidate over `seeds` runs, all in one batch */
+static int evaluate(const struct run_config *base, const struct tune *cand, int ncand,
+                    int seeds, int workers, double *cost, struct run_result *first)
+{
+    int n = ncand * seeds, k, s;
+    struct run_config *cfg = calloc(n, sizeof(*cfg));
+    struct run_result *res = calloc(n, sizeof(*res));
+
+    if (!cfg || !res) {
+        free(cfg);
+        free(res);
+        return -1;
+    }
+    for (k = 0; k < ncand; k++) {
+        for (s = 0; s < seeds; s++) {
+            cfg[k * seeds + s] = *base;
+            cfg[k * seeds + s].tune = cand[k];
+            cfg[k * seeds + s].prm.seed = base->prm.seed + s;
+        }
+    }
+    if (batch_run(cfg, res, n, workers) < 0) {
+        free(cfg);
+        free(res);
+        return -1;
+    }
+    for (k = 0; k < ncand; k++) {
+        cost[k] = 0;
+        for (s = 0; s < seeds; s++)
+            cost[k] += run_cost(&res[k * seeds + s], base->max_time) / seeds;
+        if (first)
+            first[k] = res[k * seeds];
+    }
+    free(cfg);
+    free(res);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: optimize [-t track] [-g generations] [-s seeds] [-l lambda]\n"
+                    "                [-j workers] [-o robotune.h] [NAME=value ...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct run_config base;
+    struct cmaes cma;
+    struct tune cand[CMA_MAX_LAMBDA], best;
+    struct run_result best_run;
+    double x0[CMA_MAX_N], fit[CMA_MAX_LAMBDA], pen[CMA_MAX_LAMBDA], best_cost;
+    const char *out = "robotune.h";
+    char note[128];
+    int gens = 30, seeds = 3, lambda = 0, workers = 0;
+    int g, k, opt, i;
+
+    run_config_default(&base);
+    while ((opt = getopt(argc, argv, "t:g:s:l:j:o:")) != -1) {
+        switch (opt)
+        {
+            case 't': snprintf(base.track, sizeof(base.track), "%s", optarg); break;
+            case 'g': gens = atoi(optarg); break;
+            case 's': seeds = atoi(optarg); break;
+            case 'l': lambda = atoi(optarg); break;
+            case 'j': workers = atoi(optarg); break;
+            case 'o': out = optarg; break;
+            default: usage();
+        }
+    }
+    for (i = optind; i < argc; i++)
+        if (tune_parse(&base.tune, argv[i]) < 0)
+            usage();
+    if (seeds < 1)
+        seeds = 1;
+    if (tune_constrain(&base.tune))
+        fprintf(stderr, "optimize: LIGHT_OFF_DELTA lowered to %d, below LIGHT_ON_DELTA\n",
+                base.tune.v[TUNE_LIGHT_OFF_DELTA]);
+
+    for (i = 0; i < TUNE_COUNT; i++)
+        if (tune_info[i].lo < tune_info[i].hi && ndims < CMA_MAX_N)
+            dims[ndims++] = i;
+
+    // Baseline: the constants we start from
+    if (evaluate(&base, &base.tune, 1, seeds, workers, &best_cost, &best_run) < 0)
+        return 1;
+    best = base.tune;
+    printf("start   cost %8.2f  ", best_cost);
+    tune_print(&best, " ");
+    printf("\n");
+
+    encode(&base.tune, x0);
+    cmaes_init(&cma, ndims, x0, 0.2, lambda, base.prm.seed);
+    for (g = 0; g < gens; g++) {
+        double mean = 0;
+        int gbest = 0;
+
+        cmaes_ask(&cma);
+        for (k = 0; k < cma.lambda; k++)
+            pen[k] = decode(cma.arx[k], &base.tune, &cand[k]);
+        if (evaluate(&base, cand, cma.lambda, seeds, workers, fit, 0) < 0)
+            return 1;
+        for (k = 0; k < cma.lambda; k++) {
+            fit[k] += pen[k];
+            mean += fit[k] / cma.lambda;
+            if (fit[k] < fit[gbest])
+                gbest = k;
+        }
+        if (fit[gbest] < best_cost) {
+            best_cost = fit[gbest];
+            best = cand[gbest];
+        }
+        cmaes_tell(&cma, fit);
+
+        printf("gen %3d cost %8.2f  mean %8.2f  sigma %.3f  ", g + 1, fit[gbest], mean, cma.sigma);
+        tune_print(&cand[gbest], " ");
+        printf("\n");
+        fflush(stdout);
+    }
+
+    // Re-run the winner so the report shows one of its runs in full
+    evaluate(&base, &best, 1, seeds, workers, &best_cost, &best_run);
+    printf("\nbest    cost %8.2f  ", best_cost);
+    tune_print(&best, " ");
+    printf("\n");
+    run_print(&best_run);
+
+    snprintf(note, sizeof(note), "Optimizer: cost %.2f on '%s' over %d seed(s), %d generation(s).",
+             best_cost, base.track, seeds, gens);
+    if (tune_write_header(out, &best, note) != 0) {
+        perror(out);
+        return 1;
+    }
+    printf("wrote %s\n", out);
+    return 0;
+}
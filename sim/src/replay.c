@@ -0,0 +1,370 @@
+/*
+ *   REPLAY.C -- Re-run robosample.c against a recorded telemetry log
+ *
+ *   The log is what a -DTELEMETRY build streams over the UART (see
+ *   telemetry.h).  Its line, light and proximity values were read behind
+ *   the adcscan filters, so they are set as the filter outputs in virtual
+ *   time, each held until the next recorded change.  The replayed
+ *   firmware records itself the same way; its motor commands and cp_state
+ *   changes are then compared with the recorded ones.  Exit status is 0
+ *   when they agree within the time tolerance, 1 when they do not.
+ *
+ *   usage: replay [-T tolerance_ms] [-o replayed.log] [-v] run.log
+ *                 [NAME=value ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../../hal_ext.h"
+#include "sim.h"
+#include "tune.h"
+
+#define REPLAY_TAIL_MS      1000        // keep running after the last record
+#define MAX_REPORT          10
+
+struct event
+{
+    char   tag;
+    INT32U t;                           // ms since tlm_start, unwrapped
+    int    a, b, c;
+};
+
+struct evlog
+{
+    struct event *ev;
+    int    n, cap;
+    INT32U last;                        // for unwrapping the 24-bit stamps
+    int    dropped;
+};
+
+struct cursor
+{
+    const struct evlog *lg;
+    char   tag;
+    int    i;                           // last event of this tag at or before now
+};
+
+struct replay
+{
+    struct cursor line, light, prox;
+    const struct event *line_ev;        // the L record of the current scan
+    INT32U end;
+    char  *out;                         // bytes the replayed firmware sent
+    size_t nout, capout;
+};
+
+static int log_add(struct evlog *lg, const char *s)
+{
+    struct event e;
+    unsigned int t;
+    char tag;
+    int n;
+
+    memset(&e, 0, sizeof(e));
+    n = sscanf(s, " %c %x %d %d %d", &tag, &t, &e.a, &e.b, &e.c);
+    if (n < 3 || !strchr("LIPMCD", tag))
+        return 0;                       // banner or unrelated UART output
+    e.tag = tag;
+    e.t = (lg->last & ~0xffffffUL) | t;
+    if (e.t + 0x800000UL < lg->last)
+        e.t += 0x1000000UL;
+    lg->last = e.t;
+    if (tag == 'D') {
+        lg->dropped = e.a;
+        return 0;
+    }
+    if (lg->n == lg->cap) {
+        struct event *p;
+        lg->cap = lg->cap ? 2 * lg->cap : 1024;
+        if (!(p = realloc(lg->ev, lg->cap * sizeof(*p))))
+            return -1;
+        lg->ev = p;
+    }
+    lg->ev[lg->n++] = e;
+    return 0;
+}
+
+static int log_parse(struct evlog *lg, const char *text, size_t len)
+{
+    const char *p = text, *end = text + len;
+    char line[64];
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        size_t n = (nl ? nl : end) - p;
+        if (n >= sizeof(line))
+            n = sizeof(line) - 1;
+        memcpy(line, p, n);
+        line[n] = 0;
+        if (log_add(lg, line) < 0)
+            return -1;
+        p = nl ? nl + 1 : end;
+    }
+    return 0;
+}
+
+static int log_read(struct evlog *lg, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[64];
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f))
+        if (log_add(lg, line) < 0)
+            break;
+    fclose(f);
+    return 0;
+}
+
+/* Several reads can fall in one millisecond; each takes at most one record stamped now */
+static const struct event *cursor_event(struct cursor *c, INT32U now)
+{
+    const struct evlog *lg = c->lg;
+    int i;
+
+    for (i = c->i + 1; i < lg->n && lg->ev[i].t < now; i++)
+        if (lg->ev[i].tag == c->tag)
+            c->i = i;
+    for (i = c->i + 1; i < lg->n && lg->ev[i].t <= now; i++) {
+        if (lg->ev[i].tag == c->tag && lg->ev[i].t == now) {
+            c->i = i;
+            break;
+        }
+    }
+    if (c->i < 0) {                     // read before the first record
+        for (i = 0; i < lg->n; i++)
+            if (lg->ev[i].tag == c->tag)
+                return &lg->ev[i];
+        return 0;
+    }
+    return &lg->ev[c->i];
+}
+
+static int cursor_value(struct cursor *c, INT32U now)
+{
+    const struct event *e = cursor_event(c, now);
+
+    return e ? e->a : 0;
+}
+
+static int replay_sensor(enum sim_sensor which, void *arg)
+{
+    struct replay *r = arg;
+    INT32U now = hal_millis();
+
+    switch (which)
+    {
+        case SIM_SENSOR_LINE_L:
+            r->line_ev = cursor_event(&r->line, now);   // the scan converts left first
+            return r->line_ev ? r->line_ev->a : 0;
+        case SIM_SENSOR_LINE_M: return r->line_ev ? r->line_ev->b : 0;
+        case SIM_SENSOR_LINE_R: return r->line_ev ? r->line_ev->c : 0;
+        case SIM_SENSOR_LIGHT: return cursor_value(&r->light, now);
+        case SIM_SENSOR_PROX:  return cursor_value(&r->prox, now);
+    }
+    return 0;
+}
+
+static void replay_uart(char ch, void *arg)
+{
+    struct replay *r = arg;
+
+    if (r->nout == r->capout) {
+        char *p;
+        r->capout = r->capout ? 2 * r->capout : 65536;
+        if (!(p = realloc(r->out, r->capout)))
+            return;
+        r->out = p;
+    }
+    r->out[r->nout++] = ch;
+}
+
+static int replay_tick(void *arg)
+{
+    struct replay *r = arg;
+
+    sim_hal_tick();
+    return hal_millis() >= r->end;
+}
+
+#define MOTOR_KEY(l, r)     (((l) + 500) * 1000 + (r) + 500)
+#define MOTOR_L(k)          ((k) / 1000 - 500)
+#define MOTOR_R(k)          ((k) % 1000 - 500)
+
+/* Motor command in force at every ms up to end, stopped before the first.
+   M lines are in time order among themselves only: drive.c may send one
+   after lines stamped later. */
+static int motor_series(const struct evlog *lg, INT32U end, int **out)
+{
+    int *v = malloc((end + 1) * sizeof(*v)), cur = MOTOR_KEY(0, 0), k = 0;
+    INT32U t;
+
+    if (!v)
+        return -1;
+    for (t = 0; t <= end; t++) {
+        for (; k < lg->n && (lg->ev[k].tag != 'M' || lg->ev[k].t <= t); k++)
+            if (lg->ev[k].tag == 'M')
+                cur = MOTOR_KEY(lg->ev[k].a, lg->ev[k].b);
+        v[t] = cur;
+    }
+    *out = v;
+    return 0;
+}
+
+static int near(const int *s, INT32U end, INT32U t, int v, INT32U tol)
+{
+    INT32U lo = t > tol ? t - tol : 0, hi = t + tol > end ? end : t + tol, k;
+
+    for (k = lo; k <= hi; k++)
+        if (s[k] == v)
+            return 1;
+    return 0;
+}
+
+static int diff_motors(const struct evlog *rec, const struct evlog *rep, INT32U end, INT32U tol)
+{
+    int *a, *b, reported = 0;
+    INT32U t, bad = 0, start = 0;
+    char in_bad = 0;
+
+    if (motor_series(rec, end, &a) < 0 || motor_series(rep, end, &b) < 0)
+        return -1;
+    printf("\nmotor commands (left right)\n");
+    for (t = 0; t <= end + 1; t++) {
+        char diverged = t <= end && (!near(b, end, t, a[t], tol) || !near(a, end, t, b[t], tol));
+        if (diverged) {
+            bad++;
+            if (!in_bad)
+                start = t;
+        } else if (in_bad && reported++ < MAX_REPORT) {
+            printf("  %8.3f - %8.3f s  recorded %4d %4d  replayed %4d %4d\n", start / 1000.0, t / 1000.0,
+                   MOTOR_L(a[start]), MOTOR_R(a[start]), MOTOR_L(b[start]), MOTOR_R(b[start]));
+        }
+        in_bad = diverged;
+    }
+    if (reported > MAX_REPORT)
+        printf("  ... %d more\n", reported - MAX_REPORT);
+    printf("  %s: %.3f s of %.3f s differ\n", bad ? "DIFFER" : "match", bad / 1000.0, end / 1000.0);
+    free(a);
+    free(b);
+    return bad != 0;
+}
+
+static int diff_checkpoints(const struct evlog *rec, const struct evlog *rep, INT32U tol)
+{
+    int i, j, bad = 0;
+
+    printf("\ncp_state      recorded   replayed\n");
+    for (i = 0, j = 0; i < rec->n || j < rep->n;) {
+        while (i < rec->n && rec->ev[i].tag != 'C')
+            i++;
+        while (j < rep->n && rep->ev[j].tag != 'C')
+            j++;
+        if (i >= rec->n && j >= rep->n)
+            break;
+        if (i < rec->n && j < rep->n && rec->ev[i].a == rep->ev[j].a) {
+            long d = (long)rep->ev[j].t - (long)rec->ev[i].t;
+            char late = d > (long)tol || -d > (long)tol;
+            printf("  %d         %8.3f   %8.3f%s\n", rec->ev[i].a, rec->ev[i].t / 1000.0,
+                   rep->ev[j].t / 1000.0, late ? "  DIFFER" : "");
+            bad += late;
+            i++;
+            j++;
+        } else if (i < rec->n && (j >= rep->n || rec->ev[i].t <= rep->ev[j].t)) {
+            printf("  %d         %8.3f          -  DIFFER\n", rec->ev[i].a, rec->ev[i].t / 1000.0);
+            bad++;
+            i++;
+        } else {
+            printf("  %d                -   %8.3f  DIFFER\n", rep->ev[j].a, rep->ev[j].t / 1000.0);
+            bad++;
+            j++;
+        }
+    }
+    return bad != 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: replay [-T tolerance_ms] [-o replayed.log] [-v] run.log\n"
+                    "              [NAME=value ...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct evlog rec, rep;
+    struct replay r;
+    const char *out = 0;
+    INT32U tol = 100;
+    int opt, i, differ;
+
+    memset(&rec, 0, sizeof(rec));
+    memset(&rep, 0, sizeof(rep));
+    memset(&r, 0, sizeof(r));
+    sim_tune = tune_defaults;
+    while ((opt = getopt(argc, argv, "T:o:v")) != -1) {
+        switch (opt)
+        {
+            case 'T': tol = strtoul(optarg, 0, 0); break;
+            case 'o': out = optarg; break;
+            case 'v': sim_hal_verbose(1); break;
+            default: usage();
+        }
+    }
+    if (optind >= argc)
+        usage();
+    for (i = optind + 1; i < argc; i++)
+        if (tune_parse(&sim_tune, argv[i]) < 0)
+            usage();
+    if (log_read(&rec, argv[optind]) < 0) {
+        perror(argv[optind]);
+        return 2;
+    }
+    if (rec.n == 0) {
+        fprintf(stderr, "replay: no telemetry records in %s\n", argv[optind]);
+        return 2;
+    }
+    if (rec.dropped)
+        printf("warning: the recording lost %d line(s) to a full UART buffer\n", rec.dropped);
+
+    r.line.lg = r.light.lg = r.prox.lg = &rec;
+    r.line.tag = 'L';
+    r.light.tag = 'I';
+    r.prox.tag = 'P';
+    r.line.i = r.light.i = r.prox.i = -1;
+    r.end = rec.ev[rec.n - 1].t + REPLAY_TAIL_MS;
+
+    // The world model only absorbs the motor output; the sensors come from the log
+    tracks_build(&sim_world.trk, "course");
+    world_default_params(&sim_world.prm);
+    world_init(&sim_world, &sim_world.prm);
+    sim_hal_reset();
+    sim_hal_sensors(replay_sensor, &r);
+    sim_hal_uart(replay_uart, &r);
+    sim_kernel_reset(replay_tick, &r);
+    sim_kernel_run(fw_main);
+
+    if (out) {
+        FILE *f = fopen(out, "w");
+        if (!f || fwrite(r.out, 1, r.nout, f) != r.nout) {
+            perror(out);
+            return 2;
+        }
+        fclose(f);
+    }
+    if (log_parse(&rep, r.out, r.nout) < 0) {
+        perror("replay");
+        return 2;
+    }
+
+    printf("replayed %s: %d records, %.3f s, tolerance %u ms\n", argv[optind], rec.n,
+           rec.ev[rec.n - 1].t / 1000.0, (unsigned)tol);
+    differ = diff_checkpoints(&rec, &rep, tol);
+    // Past the last record the recording says nothing about the motors
+    differ |= diff_motors(&rec, &rep, rec.ev[rec.n - 1].t, tol);
+    printf("\n%s\n", differ ? "DIFFER" : "MATCH");
+    return differ;
+}
@@ -0,0 +1,66 @@
+/*
+ *   ROBOSIM.C -- Single closed-loop run of robosample.c on a simulated track
+ *
+ *   usage: robosim [-t track] [-s seed] [-T max_seconds] [-o trace.csv]
+ *                  [-l uart.log] [-L learn_runs] [-e eeprom.bin] [-C] [-v]
+ *                  [NAME=value ...]
+ *
+ *   -o writes the robot state every tick, -l saves the firmware's UART
+ *   output (the telemetry replay.c reads), -v echoes it to stderr.
+ *   -L runs the course that many times from power-on before the reported
+ *   run, so the firmware can learn it; -e keeps the EEPROM in a file
+ *   between invocations instead.  -C first powers on with go held on the
+ *   sprint straight, so calib.c calibrates the wheels.
+ *   NAME=value overrides a robotune.h constant for this run only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "simrun.h"
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: robosim [-t track] [-s seed] [-T max_seconds] [-o trace.csv]\n"
+                    "               [-l uart.log] [-L learn_runs] [-e eeprom.bin] [-C] [-v]\n"
+                    "               [NAME=value ...]\ntracks:\n");
+    tracks_list();
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct run_config cfg;
+    struct run_result res;
+    int opt, i;
+
+    run_config_default(&cfg);
+    while ((opt = getopt(argc, argv, "t:s:T:o:l:L:e:Cv")) != -1) {
+        switch (opt)
+        {
+            case 't': snprintf(cfg.track, sizeof(cfg.track), "%s", optarg); break;
+            case 's': cfg.prm.seed = strtoull(optarg, 0, 0); break;
+            case 'T': cfg.max_time = atof(optarg); break;
+            case 'o': cfg.trace = optarg; break;
+            case 'l': cfg.uart = optarg; break;
+            case 'L': cfg.learn_runs = atoi(optarg); break;
+            case 'e': cfg.eeprom = optarg; break;
+            case 'C': cfg.calibrate = 1; break;
+            case 'v': sim_hal_verbose(1); break;
+            default: usage();
+        }
+    }
+    for (i = optind; i < argc; i++)
+        if (tune_parse(&cfg.tune, argv[i]) < 0)
+            usage();
+
+    if (sim_run(&cfg, &res) < 0) {
+        fprintf(stderr, "robosim: unknown track '%s'\n", cfg.track);
+        usage();
+    }
+    printf("track         %s\n", cfg.track);
+    run_print(&res);
+    return 0;
+}
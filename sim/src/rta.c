@@ -0,0 +1,368 @@
+/*
+ *   RTA.C -- Response-time analysis of the robosample.c task set
+ *
+ *   Reads the task set (tasks.rta by default): the interrupt handlers with
+ *   their period and WCET, the tasks with their uC/OS priority, period and
+ *   WCET, and the context switch time.  Each task's worst-case response is
+ *   found by the usual fixed-priority recurrence
+ *
+ *       R = C + B + 2 Cs + sum over ISRs   ceil(R / Ti) Ci
+ *                        + sum over higher priority tasks
+ *                              ceil(R / Tj) (Cj + 2 Cs) + ceil(R / TBj) Bj
+ *
+ *   where B is the task's occasional burst (a busy-wait in hal_robo.o) of
+ *   at most once every TB.  The set is analysed twice.  Without bursts,
+ *   the deadlines are the periods, as rtmon.c counts misses.  With them,
+ *   a job that meets a burst cannot make its period, so each task is held
+ *   to its limit instead, the wdog.c deadline past which the board is
+ *   reset.  A task with bursts and no limit misses.  The report gives
+ *   every task's response in both and whether the set is schedulable,
+ *   then, without bursts, the rate-monotonic priorities if they differ
+ *   from the ones in the file, and the shortest period, in whole OS
+ *   ticks, the control task (-c, Navig by default) could run at with
+ *   those priorities.
+ *
+ *   -j takes the context switch, OSTickISR and Navig loop times from an
+ *   avrbench report of the real image.  The Navig figure leaves out the
+ *   interrupts and switches, which the isr and ctxsw lines add.  -n skips
+ *   the analysis with bursts.  File format: see tasks.rta.
+ *
+ *   usage: rta [-j avrbench.json] [-c control_task] [-n] [tasks.rta]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_ENT         16
+#define F_CPU_MHZ       16.0
+#define GIVE_UP         100             // R past this many deadlines: not schedulable
+
+struct ent
+{
+    char   name[24];
+    int    isr;
+    int    prio;
+    double t, c;                        // us
+    double b, tb;                       // burst, us; 0 = none
+    double lim;                         // deadline with bursts, us; 0 = none
+    double r;                           // worst-case response, us
+};
+
+static struct ent ents[MAX_ENT];
+static int    nents;
+static double ctxsw_us, tick_us = 10000;
+static int    bursts;                  // analyse with them, against the limits
+
+static int read_set(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[160];
+    int  ln = 0;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        struct ent *e = &ents[nents];
+        char kind[16], *hash = strchr(line, '#');
+        double a = 0, b = 0, c = 0, d = 0, l = 0;
+        int n;
+
+        ln++;
+        if (hash)
+            *hash = 0;
+        if (sscanf(line, "%15s", kind) != 1)
+            continue;
+        if (strcmp(kind, "ctxsw") == 0 && sscanf(line, "%*s %lf", &ctxsw_us) == 1)
+            continue;
+        if (strcmp(kind, "tick") == 0 && sscanf(line, "%*s %lf", &a) == 1) {
+            tick_us = a * 1000;
+            continue;
+        }
+        if (nents == MAX_ENT) {
+            fprintf(stderr, "%s:%d: more than %d entries\n", path, ln, MAX_ENT);
+            break;
+        }
+        memset(e, 0, sizeof(*e));
+        if (strcmp(kind, "isr") == 0 && sscanf(line, "%*s %23s %lf %lf", e->name, &a, &b) == 3) {
+            e->isr = 1;
+            e->t = a * 1000;
+            e->c = b;
+        } else if (strcmp(kind, "task") == 0 &&
+                   (n = sscanf(line, "%*s %23s %d %lf %lf %lf %lf %lf", e->name, &e->prio, &a, &b, &c, &d, &l)) >= 4 &&
+                   n != 5) {
+            e->t = a * 1000;
+            e->c = b;
+            e->b = c;
+            e->tb = d * 1000;
+            e->lim = l * 1000;
+        } else {
+            fprintf(stderr, "%s:%d: bad line\n", path, ln);
+            fclose(f);
+            return -1;
+        }
+        if (e->t <= 0 || (e->b > 0 && e->tb <= 0)) {
+            fprintf(stderr, "%s:%d: period must be above 0\n", path, ln);
+            fclose(f);
+            return -1;
+        }
+        nents++;
+    }
+    fclose(f);
+    return 0;
+}
+
+static struct ent *find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < nents; i++)
+        if (strcmp(ents[i].name, name) == 0)
+            return &ents[i];
+    return 0;
+}
+
+/* "max" of metric key in an avrbench report, in us; -1 if absent */
+static double avrbench_max(const char *json, const char *key)
+{
+    char pat[40];
+    const char *p, *end;
+
+    snprintf(pat, sizeof(pat), "\"%s\":", key);
+    if (!(p = strstr(json, pat)) || !(end = strchr(p, '}')))
+        return -1;
+    if (!(p = strstr(p, "\"max\":")) || p > end)
+        return -1;
+    return atof(p + 6) / F_CPU_MHZ;
+}
+
+static int read_avrbench(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    static char json[16384];
+    size_t n;
+    double v, w;
+    struct ent *e;
+
+    if (!f)
+        return -1;
+    n = fread(json, 1, sizeof(json) - 1, f);
+    json[n] = 0;
+    fclose(f);
+    v = avrbench_max(json, "ctxsw");
+    w = avrbench_max(json, "int_ctxsw");
+    if (v > 0 || w > 0)
+        ctxsw_us = fmax(v, w);
+    if ((v = avrbench_max(json, "tick_isr")) > 0 && (e = find("OSTickISR")))
+        e->c = v;
+    if ((v = avrbench_max(json, "navig_loop")) > 0 && (e = find("Navig")))
+        e->c = v;
+    return 0;
+}
+
+/* Worst-case response of e; past GIVE_UP deadlines it stops there */
+static double response(const struct ent *e)
+{
+    double own = e->c + (bursts ? e->b : 0) + 2 * ctxsw_us, r = own, rn;
+    int j;
+
+    for (;;) {
+        rn = own;
+        for (j = 0; j < nents; j++) {
+            const struct ent *h = &ents[j];
+            if (h->isr) {
+                rn += ceil(r / h->t) * h->c;
+            } else if (h != e && h->prio < e->prio) {
+                rn += ceil(r / h->t) * (h->c + 2 * ctxsw_us);
+                if (bursts && h->b > 0)
+                    rn += ceil(r / h->tb) * h->b;
+            }
+        }
+        if (rn <= r || rn > GIVE_UP * e->t)
+            return rn;
+        r = rn;
+    }
+}
+
+/* The period, or with bursts the limit; 0 if a burst has none */
+static double deadline(const struct ent *e)
+{
+    if (!bursts)
+        return e->t;
+    if (e->lim > 0)
+        return e->lim;
+    return e->b > 0 ? 0 : e->t;
+}
+
+/* Tasks that miss their deadline */
+static int analyse(void)
+{
+    int i, miss = 0;
+
+    for (i = 0; i < nents; i++) {
+        if (ents[i].isr)
+            continue;
+        ents[i].r = response(&ents[i]);
+        if (ents[i].r > deadline(&ents[i]))
+            miss++;
+    }
+    return miss;
+}
+
+/* Shortest period first, onto the priority numbers the set already uses;
+ * returns 1 if that changed any */
+static int assign_rm(void)
+{
+    int idx[MAX_ENT], prios[MAX_ENT], n = 0, i, j, changed = 0;
+
+    for (i = 0; i < nents; i++)
+        if (!ents[i].isr)
+            idx[n++] = i;
+    for (i = 0; i < n; i++)
+        prios[i] = ents[idx[i]].prio;
+    for (i = 1; i < n; i++)                 // both in ascending order, stable
+        for (j = i; j > 0 && prios[j] < prios[j - 1]; j--) {
+            int t = prios[j]; prios[j] = prios[j - 1]; prios[j - 1] = t;
+        }
+    for (i = 1; i < n; i++)
+        for (j = i; j > 0; j--) {
+            const struct ent *a = &ents[idx[j - 1]], *b = &ents[idx[j]];
+            int t;
+            if (a->t < b->t || (a->t == b->t && a->prio <= b->prio))
+                break;
+            t = idx[j]; idx[j] = idx[j - 1]; idx[j - 1] = t;
+        }
+    for (i = 0; i < n; i++) {
+        if (ents[idx[i]].prio != prios[i])
+            changed = 1;
+        ents[idx[i]].prio = prios[i];
+    }
+    return changed;
+}
+
+static void report(int miss)
+{
+    double u = 0, uisr = 0;
+    int i, p, ntask = 0;
+
+    for (i = 0; i < nents; i++) {
+        if (ents[i].isr)
+            uisr += ents[i].c / ents[i].t;
+        else {
+            u += (ents[i].c + 2 * ctxsw_us) / ents[i].t + (bursts && ents[i].b > 0 ? ents[i].b / ents[i].tb : 0);
+            ntask++;
+        }
+    }
+    printf("%-4s  %-16s %10s %10s %10s %10s %10s\n", "prio", "task", "period ms", "wcet ms", "burst ms",
+           "due ms", "R ms");
+    for (p = 0; p < 256; p++) {
+        for (i = 0; i < nents; i++) {
+            const struct ent *e = &ents[i];
+            if (e->isr || e->prio != p)
+                continue;
+            printf("%4d  %-16s %10.1f %10.3f ", e->prio, e->name, e->t / 1000, e->c / 1000);
+            if (bursts && e->b > 0)
+                printf("%10.1f ", e->b / 1000);
+            else
+                printf("%10s ", "-");
+            if (deadline(e) > 0)
+                printf("%10.1f ", deadline(e) / 1000);
+            else
+                printf("%10s ", "none");
+            if (e->r > GIVE_UP * e->t)
+                printf("%10s  MISS\n", "unbounded");
+            else
+                printf("%10.2f%s\n", e->r / 1000, e->r > deadline(e) ? "  MISS" : "");
+        }
+    }
+    printf("load: ISRs %.1f %%, tasks %.1f %% (rate-monotonic bound for %d tasks %.1f %%)\n",
+           100 * uisr, 100 * u, ntask, 100 * ntask * (pow(2, 1.0 / ntask) - 1));
+    if (miss)
+        printf("schedulable: no, %d task(s) can miss\n", miss);
+    else
+        printf("schedulable: yes\n");
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: rta [-j avrbench.json] [-c control_task] [-n] [tasks.rta]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = "tasks.rta", *json = 0, *control = "Navig";
+    struct ent saved[MAX_ENT], *c;
+    double t_now, t_min = 0;
+    int opt, miss, k, with_bursts = 1;
+
+    while ((opt = getopt(argc, argv, "j:c:n")) != -1) {
+        switch (opt)
+        {
+            case 'j': json = optarg; break;
+            case 'c': control = optarg; break;
+            case 'n': with_bursts = 0; break;
+            default: usage();
+        }
+    }
+    if (optind < argc)
+        path = argv[optind++];
+    if (optind < argc)
+        usage();
+    if (read_set(path) < 0)
+        return 2;
+    if (json && read_avrbench(json) < 0) {
+        perror(json);
+        return 2;
+    }
+
+    printf("task set %s, context switch %.1f us%s\n\nwithout bursts, against the periods:\n", path,
+           ctxsw_us, json ? ", avrbench figures" : "");
+    miss = analyse();
+    report(miss);
+    if (with_bursts) {
+        bursts = 1;
+        printf("\nwith bursts, against the limits:\n");
+        k = analyse();
+        report(k);
+        miss += k;
+        bursts = 0;
+    } else {
+        printf("\nbursts left out (-n): a burst may still reset the board\n");
+    }
+
+    memcpy(saved, ents, sizeof(saved));
+    if (assign_rm()) {
+        printf("\nrate-monotonic priorities:\n");
+        report(analyse());
+    } else {
+        printf("\nthe priorities are rate-monotonic already\n");
+    }
+
+    // Shortest period of the control task, each with its rate-monotonic priorities
+    if (!(c = find(control)) || c->isr) {
+        fprintf(stderr, "rta: no task '%s'\n", control);
+        return 2;
+    }
+    t_now = c->t;
+    for (k = 1; k * tick_us <= GIVE_UP * t_now; k++) {
+        memcpy(ents, saved, sizeof(ents));
+        c = find(control);
+        c->t = k * tick_us;
+        assign_rm();
+        if (analyse() == 0) {
+            t_min = c->t;
+            break;
+        }
+    }
+    printf("\n%s: period %.0f ms now; ", control, t_now / 1000);
+    if (t_min > 0)
+        printf("shortest schedulable %.0f ms, %.1f Hz\n", t_min / 1000, 1e6 / t_min);
+    else
+        printf("not schedulable at any period up to %.0f ms\n", GIVE_UP * t_now / 1000);
+    return miss != 0;
+}
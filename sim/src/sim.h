@@ -0,0 +1,62 @@
+/*
+ *   SIM.H -- Glue between the virtual-time kernel, the HAL stand-in and the
+ *            firmware under test
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include "../inc/kernel.h"
+#include "world.h"
+
+#define SIM_TICK_US     (1000000UL / OS_TICKS_PER_SEC)
+#define SIM_DT          (1.0 / OS_TICKS_PER_SEC)
+
+/* kernel_sim.c */
+typedef int (*sim_tick_fn)(void *arg);      // Return nonzero to end the run
+
+struct sim_task_stats
+{
+    INT8U  used;
+    INT32U runs;                // times the task was resumed
+    double cpu_us;              // CPU time charged while the task ran
+};
+
+void   sim_kernel_reset(sim_tick_fn hook, void *arg);
+int    sim_kernel_run(int (*entry)(void));
+void   sim_cpu(double us);
+void   sim_cpu_isr(double us);          // an interrupt's: no task is held for it
+INT32U sim_now(void);
+double sim_cpu_load(void);
+double sim_busy_us(void);              // CPU time charged so far
+const struct sim_task_stats *sim_task(INT8U prio);
+
+/* hal_sim.c */
+typedef void (*sim_uart_fn)(char c, void *arg);
+
+enum sim_sensor { SIM_SENSOR_LINE_L, SIM_SENSOR_LINE_M, SIM_SENSOR_LINE_R,    // ADC counts
+                  SIM_SENSOR_LIGHT, SIM_SENSOR_PROX };                          // ADC counts, 0|1
+typedef int (*sim_sensor_fn)(enum sim_sensor which, void *arg);
+
+extern struct world sim_world;
+void   sim_hal_reset(void);
+void   sim_hal_uart(sim_uart_fn fn, void *arg);
+void   sim_hal_uart_put(char c);
+void   sim_hal_sensors(sim_sensor_fn fn, void *arg);
+void   sim_hal_verbose(int on);
+void   sim_hal_go(int held);            // robo_goPressed(): go held at power-on
+unsigned int sim_hal_adc(unsigned char channel);
+void   sim_hal_replay_scan(void);       // replay: the recorded readings as adcscan's outputs
+void   sim_hal_motor_dir(char motor, char dir);     // the pins alone, no busy-wait
+
+/* hal_ext_sim.c; erased EEPROM reads 0xff */
+#define SIM_EEPROM_SIZE 1024
+extern unsigned char sim_eeprom[SIM_EEPROM_SIZE];
+void   sim_hal_tick(void);              // one tick of Timer2 interrupt work: watchdog, wheels, ADC scan
+
+/* firmware.c */
+int    fw_main(void);
+int    fw_cp_state(void);
+int    fw_score(void);
+
+#endif
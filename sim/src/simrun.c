@@ -0,0 +1,226 @@
+/*
+ *   SIMRUN.C -- One closed-loop run of the firmware over a simulated course
+ *
+ *   The firmware's file-scope state is only initialised when the process
+ *   starts, so sim_run() may be called once per process; batch.c forks a
+ *   fresh worker for every run.  Only the EEPROM outlives a run: the
+ *   calibration run and the learn_runs before the measured one each run in
+ *   a child process and hand their EEPROM image back through a pipe.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "sim.h"
+#include "simrun.h"
+
+#define CALIB_TRACK     "sprint"
+#define CALIB_MAX_TIME  30.0        // calib.c needs ~20 s on this straight
+
+struct run_ctx
+{
+    const struct run_config *cfg;
+    struct run_result *res;
+    int    last_cp;
+    int    last_bar;
+    double end_at;
+    FILE  *trace;
+    FILE  *uart;
+};
+
+void run_config_default(struct run_config *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    strcpy(cfg->track, "course");
+    world_default_params(&cfg->prm);
+    cfg->tune = tune_defaults;
+    cfg->max_time = 180;
+}
+
+static void run_uart(char ch, void *arg)
+{
+    fputc(ch, arg);
+}
+
+static int run_tick(void *arg)
+{
+    struct run_ctx *c = arg;
+    struct run_result *r = c->res;
+    struct world *w = &sim_world;
+    int cp;
+
+    world_step(w, SIM_DT);
+    sim_hal_tick();
+
+    cp = fw_cp_state();
+    if (c->trace)
+        fprintf(c->trace, "%.2f,%.2f,%.2f,%.3f,%d,%d,%d,%d,%d\n", w->t, w->bot.p.x, w->bot.p.y,
+                w->bot.th, w->bot.pwm_l, w->bot.pwm_r, cp, w->bars_passed, w->lost);
+    if (cp == RUN_CP_DONE && c->last_cp < RUN_CP_DONE)
+        c->end_at = w->t + 0.5;
+    while (c->last_cp < cp && c->last_cp < RUN_CP_DONE)
+        r->cp_time[++c->last_cp] = w->t;
+    while (c->last_bar < w->bars_passed)
+        r->bar_time[c->last_bar++] = w->t;
+    // Over-counted bars also reach CP_DONE; finished means the robot crossed them all
+    if (cp == RUN_CP_DONE && w->bars_passed >= RUN_CP_DONE && !r->finished) {
+        r->finished = 1;
+        r->lap_time = w->t;
+    }
+    if (r->course_time == 0 && w->progress >= track_length(&w->trk) - 2) {
+        r->course_time = w->t;
+        r->line_losses = w->line_losses;
+        r->lost_time = w->lost_time;
+        if (c->end_at == 0)
+            c->end_at = w->t + 2;
+    }
+
+    if (c->end_at > 0 && w->t >= c->end_at)
+        return 1;
+    if (w->t >= c->cfg->max_time)
+        return 1;
+    return w->off_course_time > 10;     // wandered off and never came back
+}
+
+static int run_once(const struct run_config *cfg, struct run_result *res, int go_held)
+{
+    struct run_ctx c;
+    struct world *w = &sim_world;
+
+    memset(res, 0, sizeof(*res));
+    memset(&c, 0, sizeof(c));
+    c.cfg = cfg;
+    c.res = res;
+
+    if (tracks_build(&w->trk, cfg->track) < 0)
+        return -1;
+    if (cfg->trace) {
+        if (!(c.trace = fopen(cfg->trace, "w")))
+            return -1;
+        fprintf(c.trace, "t,x,y,th,pwm_l,pwm_r,cp_state,bars,lost\n");
+    }
+    if (cfg->uart && !(c.uart = fopen(cfg->uart, "w"))) {
+        if (c.trace)
+            fclose(c.trace);
+        return -1;
+    }
+    world_init(w, &cfg->prm);
+    sim_hal_reset();
+    sim_hal_go(go_held);
+    if (c.uart)
+        sim_hal_uart(run_uart, c.uart);
+    sim_tune = cfg->tune;
+    sim_kernel_reset(run_tick, &c);
+    sim_kernel_run(fw_main);
+    if (c.trace)
+        fclose(c.trace);
+    if (c.uart)
+        fclose(c.uart);
+
+    res->end_time = w->t;
+    res->progress = w->progress / track_length(&w->trk);
+    res->bars = w->trk.nbars;
+    res->bars_passed = w->bars_passed;
+    res->checkpoints = c.last_cp;
+    if (res->course_time == 0) {
+        res->line_losses = w->line_losses;
+        res->lost_time = w->lost_time;
+    }
+    res->collisions = w->collisions;
+    res->stop_dist = res->stop_time = -1;
+    if (w->trk.nobst > 0 && w->trk.obst[0].t_stop >= 0) {
+        res->stop_dist = w->trk.obst[0].stop_dist;
+        res->stop_time = w->trk.obst[0].t_stop - w->trk.obst[0].t_seen;
+    }
+    res->honks = w->honks;
+    res->score = fw_score();
+    res->cpu_load = sim_cpu_load();
+    return 0;
+}
+
+/* One untraced run from power-on in a child; sim_eeprom[] becomes what it left */
+static int child_run(const struct run_config *cfg, int go_held)
+{
+    int fds[2], status;
+    size_t got = 0;
+    ssize_t n;
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+        return -1;
+    if ((pid = fork()) < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        struct run_config lc = *cfg;
+        struct run_result r;
+        close(fds[0]);
+        lc.trace = lc.uart = 0;
+        if (run_once(&lc, &r, go_held) < 0)
+            _exit(1);
+        if (write(fds[1], sim_eeprom, sizeof(sim_eeprom)) != (ssize_t)sizeof(sim_eeprom))
+            _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    while (got < sizeof(sim_eeprom) && (n = read(fds[0], sim_eeprom + got, sizeof(sim_eeprom) - got)) > 0)
+        got += n;
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    return got == sizeof(sim_eeprom) && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+int sim_run(const struct run_config *cfg, struct run_result *res)
+{
+    FILE *f;
+    int i;
+
+    memset(sim_eeprom, 0xff, sizeof(sim_eeprom));
+    if (cfg->eeprom && (f = fopen(cfg->eeprom, "rb"))) {
+        if (fread(sim_eeprom, 1, sizeof(sim_eeprom), f) == 0)
+            memset(sim_eeprom, 0xff, sizeof(sim_eeprom));
+        fclose(f);
+    }
+    if (cfg->calibrate) {
+        struct run_config cc = *cfg;
+        strcpy(cc.track, CALIB_TRACK);
+        cc.max_time = CALIB_MAX_TIME;
+        if (child_run(&cc, 1) < 0)
+            return -1;
+    }
+    for (i = 0; i < cfg->learn_runs; i++)
+        if (child_run(cfg, 0) < 0)
+            return -1;
+    if (run_once(cfg, res, 0) < 0)
+        return -1;
+    if (cfg->eeprom) {
+        if (!(f = fopen(cfg->eeprom, "wb")))
+            return -1;
+        fwrite(sim_eeprom, 1, sizeof(sim_eeprom), f);
+        fclose(f);
+    }
+    return 0;
+}
+
+void run_print(const struct run_result *r)
+{
+    if (r->finished)
+        printf("lap time      %.2f s\n", r->lap_time);
+    else
+        printf("lap time      DNF (stopped at %.2f s)\n", r->end_time);
+    if (r->course_time > 0)
+        printf("course        %.2f s to the end of the line\n", r->course_time);
+    printf("progress      %.1f %%\n", r->progress * 100);
+    printf("bars          %d crossed, %d counted, %d on course\n", r->bars_passed, r->checkpoints, r->bars);
+    printf("line losses   %d (%.2f s lost)\n", r->line_losses, r->lost_time);
+    printf("collisions    %d\n", r->collisions);
+    if (r->stop_dist >= 0)
+        printf("obstacle stop %.1f cm in %.2f s after it came in range\n", r->stop_dist, r->stop_time);
+    printf("honks         %d\n", r->honks);
+    printf("score         %d\n", r->score);
+    printf("cpu load      %.1f %%\n", r->cpu_load * 100);
+}
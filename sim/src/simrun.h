@@ -0,0 +1,53 @@
+/*
+ *   SIMRUN.H -- One closed-loop run of the firmware over a simulated course
+ */
+
+#ifndef SIMRUN_H
+#define SIMRUN_H
+
+#include "tune.h"
+#include "world.h"
+
+#define RUN_CP_DONE     7           // CpState value of CP_DONE in robosample.c
+
+struct run_config
+{
+    char track[16];
+    struct world_params prm;
+    struct tune tune;
+    double max_time;                // seconds before the run is abandoned
+    const char *trace;              // per-tick CSV of the robot state, or 0
+    const char *uart;               // file for the firmware's UART output, or 0
+    const char *eeprom;             // EEPROM image loaded before and saved after, or 0
+    int    learn_runs;              // runs from power-on before the measured one
+    int    calibrate;               // first a calibration run on "sprint", go held at power-on
+};
+
+struct run_result
+{
+    int    failed;                  // worker crashed or the track is unknown
+    int    finished;                // firmware reached CP_DONE and the robot crossed every bar
+    double lap_time;                // start to then, seconds
+    double end_time;                // when the run stopped
+    double course_time;             // robot reached the end of the main line, or 0
+    double progress;                // fraction of the main line covered
+    int    bars;                    // bars on the course
+    int    bars_passed;             // bars the robot physically crossed
+    int    checkpoints;             // bars the firmware counted (cp_state)
+    double cp_time[8];              // time each cp_state was entered
+    double bar_time[WORLD_MAX_BARS];    // time the robot crossed each bar
+    int    line_losses;             // up to the end of the line: past it there is no tape
+    double lost_time;
+    int    collisions;
+    double stop_dist;               // cm driven after the first obstacle came in range, or -1
+    double stop_time;               // s from then to standstill, or -1
+    int    honks;
+    int    score;
+    double cpu_load;
+};
+
+void run_config_default(struct run_config *cfg);
+int  sim_run(const struct run_config *cfg, struct run_result *res);
+void run_print(const struct run_result *r);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ *   TRACKS.C -- Course library for the RoboKar host simulation
+ *
+ *   "course" follows the competition layout: start bar, L1 before A, bars
+ *   A-E, the L2 spur between C and D, one obstacle before the finish bar.
+ *   The short tracks after it each isolate one situation for bench.c.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "world.h"
+
+static void build_course(struct track *t)
+{
+    track_begin(t, "course");
+    track_straight(t, 15);
+    track_bar(t);                       // start line
+    track_straight(t, 50);
+    track_lamp(t, '1', 7, 80);          // L1 beside the first straight
+    track_straight(t, 30);
+    track_arc(t, 45, 90);
+    track_straight(t, 30);
+    track_bar(t);                       // A
+    track_straight(t, 30);
+    track_arc(t, 35, -90);
+    track_arc(t, 35, 90);
+    track_straight(t, 25);
+    track_bar(t);                       // B
+    track_straight(t, 40);
+    track_arc(t, 40, 90);
+    track_straight(t, 30);
+    track_bar(t);                       // C
+    track_straight(t, 40);
+    track_spur(t, 0, 30, '2');          // L2 at the end of a straight-on spur
+    track_arc(t, 30, -90);
+    track_straight(t, 50);
+    track_bar(t);                       // D
+    track_straight(t, 40);
+    track_arc(t, 40, 120);
+    track_straight(t, 30);
+    track_bar(t);                       // E
+    track_straight(t, 30);
+    track_obstacle(t, 40);
+    track_straight(t, 90);
+    track_arc(t, 50, 60);
+    track_straight(t, 30);
+    track_bar(t);                       // finish
+    track_straight(t, 40);
+    track_finish(t);
+}
+
+static void build_sprint(struct track *t)
+{
+    track_begin(t, "sprint");
+    track_straight(t, 15);
+    track_bar(t);
+    track_straight(t, 400);
+    track_finish(t);
+}
+
+static void build_scurve(struct track *t)
+{
+    int i;
+
+    track_begin(t, "scurve");
+    track_straight(t, 15);
+    track_bar(t);
+    track_straight(t, 30);
+    for (i = 0; i < 3; i++) {
+        track_arc(t, 30, 90);
+        track_arc(t, 30, -90);
+    }
+    track_straight(t, 40);
+    track_finish(t);
+}
+
+static void build_lost(struct track *t)
+{
+    track_begin(t, "lost");
+    track_straight(t, 15);
+    track_bar(t);
+    track_straight(t, 60);
+    track_gap(t, 6);                    // break in the tape
+    track_straight(t, 60);
+    track_arc(t, 6, -100);              // corner too tight to follow
+    track_straight(t, 80);
+    track_finish(t);
+}
+
+static void build_obstacle(struct track *t)
+{
+    track_begin(t, "obstacle");
+    track_straight(t, 15);
+    track_bar(t);
+    track_straight(t, 80);
+    track_obstacle(t, 40);
+    track_straight(t, 160);
+    track_finish(t);
+}
+
+static void build_l2spur(struct track *t)
+{
+    int i;
+
+    track_begin(t, "l2spur");
+    track_straight(t, 15);
+    for (i = 0; i < 4; i++) {           // start, A, B, C: cp_state is CP_D at the spur
+        track_bar(t);
+        track_straight(t, 25);
+    }
+    track_straight(t, 15);
+    track_spur(t, 0, 30, '2');
+    track_arc(t, 30, -90);
+    track_straight(t, 50);
+    track_bar(t);                       // D
+    track_straight(t, 40);
+    track_finish(t);
+}
+
+static void build_circuit(struct track *t)
+{
+    track_begin(t, "circuit");
+    track_straight(t, 15);
+    track_bar(t);                       // start line
+    track_straight(t, 150);
+    track_bar(t);                       // A
+    track_straight(t, 30);
+    track_arc(t, 40, 90);
+    track_straight(t, 120);
+    track_bar(t);                       // B
+    track_straight(t, 30);
+    track_arc(t, 35, -90);
+    track_arc(t, 35, 90);
+    track_straight(t, 100);
+    track_bar(t);                       // C
+    track_straight(t, 160);
+    track_bar(t);                       // D
+    track_straight(t, 30);
+    track_arc(t, 40, 90);
+    track_straight(t, 90);
+    track_bar(t);                       // E
+    track_straight(t, 130);
+    track_bar(t);                       // finish
+    track_straight(t, 40);
+    track_finish(t);
+}
+
+static const struct
+{
+    const char *name;
+    void (*build)(struct track *t);
+    const char *desc;
+} tracks[] = {
+    { "course",   build_course,   "competition layout: 7 bars, L1, L2 spur and one obstacle" },
+    { "sprint",   build_sprint,   "4 m straight" },
+    { "scurve",   build_scurve,   "three S-bends of 30 cm radius" },
+    { "lost",     build_lost,     "6 cm break in the tape, then a corner too tight to follow" },
+    { "obstacle", build_obstacle, "obstacle on a straight, approached at cruise speed" },
+    { "l2spur",   build_l2spur,   "four bars, then the L2 spur where the reverse maneuver runs" },
+    { "circuit",  build_circuit,  "7 bars with long straights between corners, for track learning" },
+};
+
+int tracks_build(struct track *t, const char *name)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(tracks) / sizeof(tracks[0]); i++) {
+        if (strcmp(tracks[i].name, name) == 0) {
+            tracks[i].build(t);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void tracks_list(void)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(tracks) / sizeof(tracks[0]); i++)
+        printf("  %-10s %s\n", tracks[i].name, tracks[i].desc);
+}
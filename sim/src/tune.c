@@ -0,0 +1,109 @@
+/*
+ *   TUNE.C -- Defaults, parsing and header export for the tunable constants
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tune.h"
+#include "../../robotune.h"
+
+#define NOTE_COLUMN  32
+
+struct tune sim_tune;
+
+const struct tune tune_defaults = { {
+#define TUNE_DEFAULT(name, group, lo, hi, note) name,
+    TUNE_FIELDS(TUNE_DEFAULT)
+#undef TUNE_DEFAULT
+} };
+
+const struct tune_info tune_info[TUNE_COUNT] = {
+#define TUNE_INFO(name, group, lo, hi, note) { #name, group, lo, hi, note },
+    TUNE_FIELDS(TUNE_INFO)
+#undef TUNE_INFO
+};
+
+int tune_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < TUNE_COUNT; i++)
+        if (strcmp(tune_info[i].name, name) == 0)
+            return i;
+    return -1;
+}
+
+/* "NAME=value" */
+int tune_parse(struct tune *t, const char *assign)
+{
+    char name[32];
+    const char *eq = strchr(assign, '=');
+    size_t len;
+    int i;
+
+    if (!eq || (len = (size_t)(eq - assign)) >= sizeof(name))
+        return -1;
+    memcpy(name, assign, len);
+    name[len] = 0;
+    if ((i = tune_find(name)) < 0)
+        return -1;
+    t->v[i] = atoi(eq + 1);
+    return 0;
+}
+
+/* Lowers LIGHT_OFF_DELTA below LIGHT_ON_DELTA, or lightsens.c would have no
+ * hysteresis, or an inverted one; returns by how much */
+int tune_constrain(struct tune *t)
+{
+    int max_off = t->v[TUNE_LIGHT_ON_DELTA] - TUNE_LIGHT_MIN_GAP, over = t->v[TUNE_LIGHT_OFF_DELTA] - max_off;
+
+    if (over <= 0)
+        return 0;
+    t->v[TUNE_LIGHT_OFF_DELTA] = max_off;
+    return over;
+}
+
+int tune_write_header(const char *path, const struct tune *t, const char *note)
+{
+    FILE *f = fopen(path, "w");
+    int i;
+
+    if (!f)
+        return -1;
+    fprintf(f, "/*\n"
+               " *   ROBOTUNE.H -- Speed and threshold constants for robosample.c\n"
+               " *\n"
+               " *   This file may be regenerated by the gain optimizer in sim/ (see\n"
+               " *   sim/src/optimize.c).  Hand edits are fine; keep the names unchanged.\n");
+    if (note)
+        fprintf(f, " *\n *   %s\n", note);
+    fprintf(f, " */\n\n#ifndef ROBOTUNE_H\n#define ROBOTUNE_H\n");
+
+    for (i = 0; i < TUNE_COUNT; i++) {
+        int n;
+
+        if (i == 0 || tune_info[i].group != tune_info[i - 1].group)
+            fputc('\n', f);
+        n = fprintf(f, "#define %-15s %3d", tune_info[i].name, t->v[i]);
+        if (tune_info[i].note)
+            fprintf(f, "%*s// %s", n < NOTE_COLUMN ? NOTE_COLUMN - n : 1, "", tune_info[i].note);
+        fputc('\n', f);
+    }
+    fprintf(f, "\n#endif\n");
+    return fclose(f);
+}
+
+/* Prints the searched constants only */
+void tune_print(const struct tune *t, const char *sep)
+{
+    const char *s = "";
+    int i;
+
+    for (i = 0; i < TUNE_COUNT; i++) {
+        if (tune_info[i].lo < tune_info[i].hi) {
+            printf("%s%s=%d", s, tune_info[i].name, t->v[i]);
+            s = sep;
+        }
+    }
+}
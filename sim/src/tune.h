@@ -0,0 +1,61 @@
+/*
+ *   TUNE.H -- robotune.h constants as run-time parameters of the simulation
+ *
+ *   TUNE_FIELDS lists every constant of robotune.h with its group (a blank
+ *   line separates groups in the generated header) and the range the
+ *   optimizer may search.  lo == hi marks a constant that is not searched.
+ *   The ranges are searched independently; tune_constrain() then enforces
+ *   what the firmware needs between constants.
+ */
+
+#ifndef TUNE_H
+#define TUNE_H
+
+#define TUNE_FIELDS(X) \
+    X(STOP_SPEED,        0,   0,   0, 0) \
+    X(VERY_LOW_SPEED,    0,  10,  40, 0) \
+    X(LOW_SPEED,         0,  15,  60, 0) \
+    X(MEDIUM_SPEED,      0,  25,  90, 0) \
+    X(HIGH_SPEED,        0,   0,   0, 0) \
+    X(REVERSE_SPEED,     0, -60, -10, 0) \
+    X(TURN_GENTLE_PCT,   1,  40, 100, "inner wheel % of cruise on codes 3/6") \
+    X(TURN_SHARP_PCT,    1,  10, 100, "inner wheel % of cruise on codes 1/4") \
+    X(LIGHT_ON_DELTA,    2,  20,  80, "light level (0-100) above ambient taken as a lamp") \
+    X(LIGHT_OFF_DELTA,   2,   5,  60, "and below which the lamp is left behind") \
+    X(SLEW_ACCEL,        3,   1,  40, "wheel speed change per tick, speeding up") \
+    X(SLEW_DECEL,        3,   1,  40, "wheel speed change per tick, slowing down")
+
+#define TUNE_LIGHT_MIN_GAP  5       // LIGHT_OFF_DELTA at least this far below LIGHT_ON_DELTA
+
+enum
+{
+#define TUNE_ENUM(name, group, lo, hi, note) TUNE_##name,
+    TUNE_FIELDS(TUNE_ENUM)
+#undef TUNE_ENUM
+    TUNE_COUNT
+};
+
+struct tune
+{
+    int v[TUNE_COUNT];
+};
+
+struct tune_info
+{
+    const char *name;
+    int group;
+    int lo, hi;
+    const char *note;
+};
+
+extern struct tune sim_tune;                // values seen by the firmware
+extern const struct tune tune_defaults;     // values of robotune.h at build time
+extern const struct tune_info tune_info[TUNE_COUNT];
+
+int  tune_find(const char *name);
+int  tune_parse(struct tune *t, const char *assign);
+int  tune_constrain(struct tune *t);
+int  tune_write_header(const char *path, const struct tune *t, const char *note);
+void tune_print(const struct tune *t, const char *sep);
+
+#endif
@@ -0,0 +1,533 @@
+/*
+ *   WORLD.C -- Track and robot model for the RoboKar host simulation
+ *
+ *   Differential drive with a first-order motor lag, three reflectance
+ *   sensors ahead of the axle, one light sensor, one forward proximity
+ *   sensor and a battery that sags over time.  Sensor values come out as raw
+ *   10-bit ADC counts so the HAL stand-in can reuse the target conversions.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include "world.h"
+
+#define WHEEL_BASE      10.0        // cm between wheels
+#define SENSOR_AHEAD     6.0        // line sensors ahead of the axle
+#define SENSOR_PITCH     1.6        // lateral spacing of the line sensors
+#define LIGHT_AHEAD      5.0
+#define LINE_HALF_W      0.95       // 19 mm tape
+#define EDGE_W           0.3        // soft edge of the reflectance footprint
+#define BAR_HALF_LEN     6.0        // half length of a full bar across the course
+#define BAR_HALF_W       1.0
+#define ROBOT_RADIUS     8.0
+#define PROX_RANGE      15.0        // from the front of the robot
+#define PROX_CONE        0.45       // half angle, radians
+#define MOTOR_TAU        0.08
+#define STANDSTILL       0.5        // cm/s taken as stopped
+#define VBAT_NOMINAL     7.4
+#define LAMP_R0          8.0
+#define COARSE_STEP      8
+
+static double clampd(double v, double lo, double hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static struct vec body_point(const struct robot *b, double ahead, double left)
+{
+    struct vec v;
+    double c = cos(b->th), s = sin(b->th);
+    v.x = b->p.x + ahead * c - left * s;
+    v.y = b->p.y + ahead * s + left * c;
+    return v;
+}
+
+static double dist2(struct vec a, struct vec b)
+{
+    double dx = a.x - b.x, dy = a.y - b.y;
+    return dx * dx + dy * dy;
+}
+
+static double seg_dist(struct vec p, struct vec a, struct vec b)
+{
+    double vx = b.x - a.x, vy = b.y - a.y;
+    double l2 = vx * vx + vy * vy;
+    double u = l2 > 0 ? ((p.x - a.x) * vx + (p.y - a.y) * vy) / l2 : 0;
+    struct vec q;
+    u = clampd(u, 0, 1);
+    q.x = a.x + u * vx;
+    q.y = a.y + u * vy;
+    return sqrt(dist2(p, q));
+}
+
+static int in_gap(const struct track *t, int j)
+{
+    int g;
+
+    for (g = 0; g < t->ngaps; g++)
+        if (j >= t->gap[g].i0 && j < t->gap[g].i1)
+            return 1;
+    return 0;
+}
+
+/* Distance from p to the tape of a line; coarse pass on every COARSE_STEP-th point */
+static double line_dist(const struct track *t, int li, struct vec p)
+{
+    const struct polyline *l = &t->line[li];
+    double best = 1e9;
+    double reach = COARSE_STEP + 2.0;
+    int i, j;
+
+    for (i = 0; i < l->n - 1; i += COARSE_STEP) {
+        if (dist2(p, l->p[i]) > reach * reach && i + COARSE_STEP < l->n - 1)
+            continue;
+        for (j = i; j < i + COARSE_STEP && j < l->n - 1; j++) {
+            double d;
+            if (li == 0 && in_gap(t, j))
+                continue;
+            d = seg_dist(p, l->p[j], l->p[j + 1]);
+            if (d < best)
+                best = d;
+        }
+    }
+    return best;
+}
+
+/* Fraction of the sensor footprint that sees black, 0..1 */
+static double line_cover(const struct world *w, struct vec p)
+{
+    const struct track *t = &w->trk;
+    double d = 1e9, cov;
+    int i;
+
+    for (i = 0; i < t->nlines; i++) {
+        double di = line_dist(t, i, p);
+        if (di < d)
+            d = di;
+    }
+    cov = clampd((LINE_HALF_W - d) / EDGE_W + 0.5, 0, 1);
+
+    for (i = 0; i < t->nbars; i++) {
+        const struct bar *b = &t->bar[i];
+        double dx = p.x - b->c.x, dy = p.y - b->c.y;
+        double along = dx * b->dir.x + dy * b->dir.y;
+        double across = -dx * b->dir.y + dy * b->dir.x;
+        if (fabs(across) <= BAR_HALF_LEN) {
+            double c = clampd((BAR_HALF_W - fabs(along)) / EDGE_W + 0.5, 0, 1);
+            if (c > cov)
+                cov = c;
+        }
+    }
+    return cov;
+}
+
+double world_uniform(struct world *w)
+{
+    unsigned long long z = (w->rng += 0x9e3779b97f4a7c15ULL);   // splitmix64
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double world_gauss(struct world *w)
+{
+    double u1 = world_uniform(w), u2 = world_uniform(w);
+    if (u1 < 1e-12)
+        u1 = 1e-12;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+void world_default_params(struct world_params *prm)
+{
+    memset(prm, 0, sizeof(*prm));
+    prm->floor_adc = 700;
+    prm->line_adc = 120;
+    prm->adc_noise = 8;
+    prm->ambient = 30;
+    prm->lamp_gain = 1.0;
+    prm->gain_l = 1.0;
+    prm->gain_r = 1.0;
+    prm->deadband = 20;
+    prm->vmax = 60;
+    prm->vbat = VBAT_NOMINAL;
+    prm->vbat_sag = 0.02;
+    prm->obstacle_hold = 3.0;
+    prm->seed = 1;
+}
+
+/* Resets everything but the track, which must already be built into w->trk */
+void world_init(struct world *w, const struct world_params *prm)
+{
+    int i;
+
+    memset(&w->prm, 0, sizeof(*w) - offsetof(struct world, prm));
+    for (i = 0; i < w->trk.nobst; i++) {
+        w->trk.obst[i].t_seen = -1;
+        w->trk.obst[i].t_stop = -1;
+        w->trk.obst[i].stop_dist = 0;
+        w->trk.obst[i].removed = 0;
+    }
+    w->prm = *prm;
+    w->rng = prm->seed * 0x2545f4914f6cdd1dULL + 1;
+    w->bot.p = w->trk.start;
+    w->bot.th = w->trk.start_th;
+}
+
+double world_vbat(const struct world *w)
+{
+    return w->prm.vbat - w->prm.vbat_sag * w->t / 60.0;
+}
+
+static double wheel_target(const struct world *w, int pwm, double gain)
+{
+    double mag = fabs((double)pwm) - w->prm.deadband;
+    double v;
+    if (mag <= 0)
+        return 0;
+    v = mag / (250.0 - w->prm.deadband) * w->prm.vmax * gain * world_vbat(w) / VBAT_NOMINAL;
+    return pwm < 0 ? -v : v;
+}
+
+static int blocked(struct world *w, struct vec p)
+{
+    int i;
+    for (i = 0; i < w->trk.nobst; i++) {
+        const struct obstacle *o = &w->trk.obst[i];
+        double r = o->r + ROBOT_RADIUS;
+        if (!o->removed && dist2(p, o->p) < r * r)
+            return 1;
+    }
+    return 0;
+}
+
+static void update_obstacles(struct world *w)
+{
+    struct vec front = body_point(&w->bot, ROBOT_RADIUS, 0);
+    int i;
+
+    for (i = 0; i < w->trk.nobst; i++) {
+        struct obstacle *o = &w->trk.obst[i];
+        double reach = o->r + PROX_RANGE;
+        if (o->removed)
+            continue;
+        if (o->t_seen < 0 && dist2(front, o->p) < reach * reach) {
+            o->t_seen = w->t;
+            o->odo_seen = w->odo;
+        }
+        if (o->t_seen >= 0 && o->t_stop < 0 &&
+            fabs(w->bot.vl) < STANDSTILL && fabs(w->bot.vr) < STANDSTILL) {
+            o->t_stop = w->t;
+            o->stop_dist = w->odo - o->odo_seen;
+        }
+        if (o->t_seen >= 0 && w->t - o->t_seen > w->prm.obstacle_hold)
+            o->removed = 1;
+    }
+}
+
+static void update_truth(struct world *w, double dt)
+{
+    const struct track *t = &w->trk;
+    const struct polyline *m = &t->line[0];
+    struct vec sp = body_point(&w->bot, SENSOR_AHEAD, 0);
+    int lo = w->prog_idx - 20, hi = w->prog_idx + 40;
+    int i, best = -1, on = 0;
+    double bd = 1e9;
+
+    if (lo < 0)
+        lo = 0;
+    if (hi > m->n)
+        hi = m->n;
+    for (i = lo; i < hi; i++) {
+        double d = dist2(sp, m->p[i]);
+        if (d < bd) {
+            bd = d;
+            best = i;
+        }
+    }
+    if (best >= 0 && bd < 10.0 * 10.0) {
+        w->prog_idx = best;
+        if (t->s[best] > w->progress)
+            w->progress = t->s[best];
+    }
+    while (w->bars_passed < t->nbars && t->bar[w->bars_passed].s <= w->progress)
+        w->bars_passed++;
+
+    for (i = -1; i <= 1; i++)
+        if (line_cover(w, body_point(&w->bot, SENSOR_AHEAD, i * SENSOR_PITCH)) > 0.5)
+            on = 1;
+    if (!on) {
+        w->lost_ticks++;
+        w->lost_time += dt;
+        if (w->lost_ticks == 3)
+            w->line_losses++;
+    } else {
+        w->lost_ticks = 0;
+    }
+    w->lost = !on;
+    if (sqrt(bd) > 30.0 && !on)
+        w->off_course_time += dt;
+    else
+        w->off_course_time = 0;
+}
+
+void world_step(struct world *w, double dt)
+{
+    struct robot *b = &w->bot;
+    double k = dt / MOTOR_TAU;
+    double v, om;
+    struct vec np;
+    int hit;
+
+    b->vl += (wheel_target(w, b->pwm_l, w->prm.gain_l) - b->vl) * k;
+    b->vr += (wheel_target(w, b->pwm_r, w->prm.gain_r) - b->vr) * k;
+    v = (b->vl + b->vr) / 2;
+    om = (b->vr - b->vl) / WHEEL_BASE;
+
+    np.x = b->p.x + v * cos(b->th) * dt;
+    np.y = b->p.y + v * sin(b->th) * dt;
+    hit = blocked(w, np);
+    if (hit && !w->contact)
+        w->collisions++;
+    w->contact = hit;
+    if (!hit) {
+        b->p = np;
+        w->odo += fabs(v) * dt;
+    }
+    b->th += om * dt;
+
+    w->t += dt;
+    update_obstacles(w);
+    update_truth(w, dt);
+}
+
+static unsigned int to_adc(struct world *w, double v)
+{
+    v += w->prm.adc_noise * world_gauss(w);
+    return (unsigned int)clampd(v + 0.5, 0, 1023);
+}
+
+static unsigned int prox_adc(struct world *w)
+{
+    struct vec front = body_point(&w->bot, ROBOT_RADIUS, 0);
+    int i;
+
+    for (i = 0; i < w->trk.nobst; i++) {
+        const struct obstacle *o = &w->trk.obst[i];
+        double dx = o->p.x - front.x, dy = o->p.y - front.y;
+        double d = sqrt(dx * dx + dy * dy) - o->r;
+        double a = atan2(dy, dx) - w->bot.th;
+        a = atan2(sin(a), cos(a));
+        if (!o->removed && d < PROX_RANGE && fabs(a) < PROX_CONE)
+            return to_adc(w, 40);
+    }
+    return to_adc(w, 600);
+}
+
+static double light_level(struct world *w)
+{
+    struct vec p = body_point(&w->bot, LIGHT_AHEAD, 0);
+    double l = w->prm.ambient;
+    int i;
+
+    for (i = 0; i < w->trk.nlamps; i++) {
+        double d2 = dist2(p, w->trk.lamp[i].p);
+        l += w->prm.lamp_gain * w->trk.lamp[i].intensity / (1 + d2 / (LAMP_R0 * LAMP_R0));
+    }
+    return clampd(l, 0, 100);
+}
+
+unsigned int world_adc(struct world *w, int ch)
+{
+    double cov;
+
+    switch (ch)
+    {
+        case ADC_CH_PROX:
+            return prox_adc(w);
+        case ADC_CH_LINE_L:
+        case ADC_CH_LINE_M:
+        case ADC_CH_LINE_R:
+            cov = line_cover(w, body_point(&w->bot, SENSOR_AHEAD, (ADC_CH_LINE_M - ch) * SENSOR_PITCH));
+            return to_adc(w, w->prm.floor_adc - (w->prm.floor_adc - w->prm.line_adc) * cov);
+        case ADC_CH_LIGHT:
+            // Inverse of robo_lightSensor: light = (5115 - 5 * adc) / 51
+            return to_adc(w, (5115.0 - 51.0 * light_level(w)) / 5.0);
+        case ADC_CH_BATT:
+            // Pack through the 1:2 divider drive.h assumes (DRIVE_BATT_FULL_MV)
+            return to_adc(w, world_vbat(w) / 2.0 / 5.0 * 1023.0);
+        default:
+            return to_adc(w, 0);
+    }
+}
+
+int world_bump(struct world *w, int right)
+{
+    struct vec side = body_point(&w->bot, ROBOT_RADIUS * 0.7, right ? -ROBOT_RADIUS * 0.7 : ROBOT_RADIUS * 0.7);
+    int i;
+
+    for (i = 0; i < w->trk.nobst; i++) {
+        const struct obstacle *o = &w->trk.obst[i];
+        if (!o->removed && dist2(side, o->p) < (o->r + 1) * (o->r + 1))
+            return 1;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------
+ *  Track builder
+ * ------------------------------------------------------------------------- */
+
+static void push_point(struct polyline *l, struct vec p)
+{
+    if (l->n < WORLD_MAX_POINTS)
+        l->p[l->n++] = p;
+}
+
+static struct vec line_end(const struct track *t)
+{
+    return t->line[0].p[t->line[0].n - 1];
+}
+
+void track_begin(struct track *t, const char *name)
+{
+    struct vec o = { 0, 0 };
+
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->nlines = 1;
+    push_point(&t->line[0], o);
+    t->start.x = -SENSOR_AHEAD;
+    t->start.y = 0;
+}
+
+void track_straight(struct track *t, double len)
+{
+    struct vec e = line_end(t), p;
+    int i, n = (int)(len + 0.5);
+
+    for (i = 1; i <= n; i++) {
+        p.x = e.x + i * cos(t->heading);
+        p.y = e.y + i * sin(t->heading);
+        push_point(&t->line[0], p);
+    }
+}
+
+/* Straight stretch with the tape missing */
+void track_gap(struct track *t, double len)
+{
+    struct gap *g;
+
+    if (t->ngaps >= WORLD_MAX_GAPS)
+        return;
+    g = &t->gap[t->ngaps++];
+    g->i0 = t->line[0].n - 1;
+    track_straight(t, len);
+    g->i1 = t->line[0].n - 1;
+}
+
+/* Positive degrees turn left (counter-clockwise) */
+void track_arc(struct track *t, double radius, double deg)
+{
+    struct vec e = line_end(t), c, p;
+    double sweep = deg * M_PI / 180.0;
+    double side = sweep >= 0 ? 1 : -1;
+    double a0 = t->heading - side * M_PI / 2;
+    int i, n = (int)(fabs(sweep) * radius + 0.5);
+
+    c.x = e.x - radius * cos(a0);
+    c.y = e.y - radius * sin(a0);
+    for (i = 1; i <= n; i++) {
+        double a = a0 + sweep * i / n;
+        p.x = c.x + radius * cos(a);
+        p.y = c.y + radius * sin(a);
+        push_point(&t->line[0], p);
+    }
+    t->heading += sweep;
+}
+
+void track_bar(struct track *t)
+{
+    struct bar *b;
+
+    if (t->nbars >= WORLD_MAX_BARS)
+        return;
+    b = &t->bar[t->nbars++];
+    b->c = line_end(t);
+    b->dir.x = cos(t->heading);
+    b->dir.y = sin(t->heading);
+    b->s = t->line[0].n - 1;
+}
+
+void track_lamp(struct track *t, char id, double side, double intensity)
+{
+    struct lamp *l;
+    struct vec e = line_end(t);
+
+    if (t->nlamps >= WORLD_MAX_LAMPS)
+        return;
+    l = &t->lamp[t->nlamps++];
+    l->p.x = e.x - side * sin(t->heading);
+    l->p.y = e.y + side * cos(t->heading);
+    l->intensity = intensity;
+    l->id = id;
+}
+
+void track_obstacle(struct track *t, double ahead)
+{
+    struct obstacle *o;
+    struct vec e = line_end(t);
+
+    if (t->nobst >= WORLD_MAX_OBST)
+        return;
+    o = &t->obst[t->nobst++];
+    o->p.x = e.x + ahead * cos(t->heading);
+    o->p.y = e.y + ahead * sin(t->heading);
+    o->r = 4.0;
+    o->t_seen = -1;
+    o->t_stop = -1;
+}
+
+/* Dead-end branch leaving the current end of the main line */
+void track_spur(struct track *t, double deg, double len, char lamp_id)
+{
+    struct polyline *l;
+    struct vec e = line_end(t), p = e;
+    double h = t->heading + deg * M_PI / 180.0;
+    int i, n = (int)(len + 0.5);
+
+    if (t->nlines >= WORLD_MAX_LINES)
+        return;
+    l = &t->line[t->nlines++];
+    l->n = 0;
+    for (i = 0; i <= n; i++) {
+        p.x = e.x + i * cos(h);
+        p.y = e.y + i * sin(h);
+        push_point(l, p);
+    }
+    if (lamp_id && t->nlamps < WORLD_MAX_LAMPS) {
+        struct lamp *lp = &t->lamp[t->nlamps++];
+        lp->p.x = p.x + 4 * cos(h);
+        lp->p.y = p.y + 4 * sin(h);
+        lp->intensity = 80;
+        lp->id = lamp_id;
+    }
+}
+
+double track_length(const struct track *t)
+{
+    return t->s[t->line[0].n - 1];
+}
+
+void track_finish(struct track *t)
+{
+    const struct polyline *m = &t->line[0];
+    int i;
+
+    t->s[0] = 0;
+    for (i = 1; i < m->n; i++)
+        t->s[i] = t->s[i - 1] + sqrt(dist2(m->p[i], m->p[i - 1]));
+    for (i = 0; i < t->nbars; i++)
+        t->bar[i].s = t->s[(int)t->bar[i].s];
+}
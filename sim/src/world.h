@@ -0,0 +1,156 @@
+/*
+ *   WORLD.H -- Track and robot model for the RoboKar host simulation
+ *
+ *   Units are centimetres, seconds and radians.  The main course is a
+ *   polyline sampled every centimetre; full bars, lamps and obstacles are
+ *   placed along it while the track is being built (see tracks.c).
+ */
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#define WORLD_MAX_LINES   4         // main course plus spurs
+#define WORLD_MAX_POINTS  4096
+#define WORLD_MAX_BARS    8
+#define WORLD_MAX_LAMPS   4
+#define WORLD_MAX_OBST    4
+#define WORLD_MAX_GAPS    4
+
+#define ADC_CH_PROX       0         // Channel map of hal_robo.o
+#define ADC_CH_LINE_L     1
+#define ADC_CH_LINE_M     2
+#define ADC_CH_LINE_R     3
+#define ADC_CH_LIGHT      4
+#define ADC_CH_BATT       5
+
+struct vec { double x, y; };
+
+struct polyline
+{
+    struct vec p[WORLD_MAX_POINTS];
+    int n;
+};
+
+struct bar
+{
+    struct vec c;                   // centre of the bar
+    struct vec dir;                 // unit vector along the course
+    double s;                       // arc length of the bar on the main line
+};
+
+struct lamp
+{
+    struct vec p;
+    double intensity;               // percent added right at the lamp
+    char id;                        // '1' for L1, '2' for L2
+};
+
+struct obstacle
+{
+    struct vec p;
+    double r;
+    double t_seen;                  // first time the robot was within sensing range
+    double odo_seen;                // odometer at t_seen
+    double t_stop;                  // first standstill after t_seen, or -1
+    double stop_dist;               // distance driven from t_seen to t_stop
+    char removed;
+};
+
+struct gap
+{
+    int i0, i1;                     // main-line points with no tape between them
+};
+
+struct track
+{
+    const char *name;
+    struct polyline line[WORLD_MAX_LINES];  // line[0] is the main course
+    int nlines;
+    double s[WORLD_MAX_POINTS];             // arc length of each main-line point
+    struct bar bar[WORLD_MAX_BARS];
+    int nbars;
+    struct lamp lamp[WORLD_MAX_LAMPS];
+    int nlamps;
+    struct obstacle obst[WORLD_MAX_OBST];
+    int nobst;
+    struct gap gap[WORLD_MAX_GAPS];
+    int ngaps;
+    struct vec start;
+    double start_th;
+    double heading;                         // builder state: heading at the end of line[0]
+};
+
+/* Physical constants and the knobs the Monte-Carlo runs perturb */
+struct world_params
+{
+    double floor_adc;               // line-sensor ADC over bare floor
+    double line_adc;                // line-sensor ADC over the black line
+    double adc_noise;               // ADC noise, standard deviation in counts
+    double ambient;                 // ambient light as robo_lightSensor reports it (0-100)
+    double lamp_gain;               // scale of lamp intensity
+    double gain_l, gain_r;          // per-wheel motor gain (asymmetry)
+    double deadband;                // PWM counts that do not move the wheel
+    double vmax;                    // wheel speed at full PWM and nominal battery, cm/s
+    double vbat;                    // battery voltage at the start of the run
+    double vbat_sag;                // volts lost per minute of running
+    double obstacle_hold;           // seconds an obstacle stays after the robot reaches it
+    unsigned long long seed;
+};
+
+struct robot
+{
+    struct vec p;
+    double th;
+    double vl, vr;                  // wheel surface speeds
+    int pwm_l, pwm_r;               // signed PWM on each wheel, -250..250
+};
+
+struct world
+{
+    struct track trk;
+    struct world_params prm;
+    struct robot bot;
+    double t;
+    unsigned long long rng;
+    char led;
+    int honks;
+
+    /* Ground truth bookkeeping, updated every step */
+    int prog_idx;                   // nearest main-line point while on course
+    double progress;                // furthest arc length reached
+    int bars_passed;
+    char lost;
+    int lost_ticks;
+    int line_losses;
+    double lost_time;
+    char contact;
+    int collisions;
+    double off_course_time;
+    double odo;                     // distance driven by the robot centre
+};
+
+void   world_default_params(struct world_params *prm);
+void   world_init(struct world *w, const struct world_params *prm);
+void   world_step(struct world *w, double dt);
+unsigned int world_adc(struct world *w, int ch);
+int    world_bump(struct world *w, int right);
+double world_vbat(const struct world *w);
+double world_gauss(struct world *w);
+double world_uniform(struct world *w);
+
+/* Track builder */
+void   track_begin(struct track *t, const char *name);
+void   track_straight(struct track *t, double len);
+void   track_gap(struct track *t, double len);
+void   track_arc(struct track *t, double radius, double deg);
+void   track_bar(struct track *t);
+void   track_lamp(struct track *t, char id, double side, double intensity);
+void   track_obstacle(struct track *t, double ahead);
+void   track_spur(struct track *t, double deg, double len, char lamp_id);
+double track_length(const struct track *t);
+void   track_finish(struct track *t);
+
+int    tracks_build(struct track *t, const char *name);
+void   tracks_list(void);
+
+#endif
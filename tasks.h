@@ -0,0 +1,44 @@
+/*
+ *   TASKS.H -- The task table of robosample.c
+ *
+ *   Every task: function, priority, stack bytes, watchdog deadline and
+ *   nominal period in ms (0 = not supervised, not monitored).  The stacks,
+ *   the task count and the creation, wdog.c and rtmon.c set-up all follow
+ *   from this table, and so do the sizes of the per-priority arrays in
+ *   wdog.c and rtmon.c (TASK_NPRIO); TaskStart, which creates the rest,
+ *   must come first.  A stack needs the task's own deepest call plus what
+ *   the interrupts take on top of it: OSTickISR saves all 32 registers and
+ *   then re-enables interrupts, so Timer2 (wdog_isr, drive_isr), ADC or
+ *   UART can nest on it.  avrbench reports that as isr_stack, and the K
+ *   telemetry lines give the high-water marks to trim by.  The sizes below
+ *   are still estimates from that sum; none has been trimmed to a mark yet.
+ */
+
+#ifndef TASKS_H
+#define TASKS_H
+
+#define TASK_CHKCOLLIDE_PRIO     2
+#define TASK_NAVIG_PRIO          4
+#define TASK_START_PRIO          5  // lowest: runs the jobs, then sleeps the CPU
+
+// Longest a task may go without checking in (wdog.c); each covers the
+// task's longest block plus a honk at CheckCollision's priority
+#define WDOG_START_MS         4000  // below Navig: waits out its blocks too
+#define WDOG_CHKCOLLIDE_MS    1000  // honks itself
+#define WDOG_NAVIG_MS         4000  // 2.5 s obstacle maneuver, or a track map save
+
+// Nominal periods, the deadlines rtmon.c counts misses against
+#define CHKCOLLIDE_PERIOD_MS   100
+#define NAVIG_PERIOD_MS        100
+
+#define TASKS(X) \
+    X(TaskStart,      TASK_START_PRIO,      192, WDOG_START_MS,      0)                      \
+    X(CheckCollision, TASK_CHKCOLLIDE_PRIO, 128, WDOG_CHKCOLLIDE_MS, CHKCOLLIDE_PERIOD_MS)   \
+    X(Navig,          TASK_NAVIG_PRIO,      160, WDOG_NAVIG_MS,      NAVIG_PERIOD_MS)
+
+// Highest priority number in TASKS + 1: a union is as large as its largest member
+#define TASK_PRIO_SLOT(fn, prio, stk, wdog, period)     char fn[(prio) + 1];
+union task_prio_slots { TASKS(TASK_PRIO_SLOT) };
+#define TASK_NPRIO          sizeof(union task_prio_slots)
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ *   TELEMETRY.C -- Sensor/motor recorder streamed over the UART
+ *   See telemetry.h for the line format.
+ */
+
+#include <avr/pgmspace.h>
+#include "telemetry.h"
+#include "hal_ext.h"
+
+static const char hex[] PROGMEM = "0123456789abcdef";
+
+static INT32U t0;
+static INT16U dropped, dropped_sent;
+
+static char *put_int(char *p, int v)
+{
+    char digits[6];
+    unsigned char n = 0;
+    unsigned int u = v < 0 ? -v : v;
+
+    *p++ = ' ';
+    if (v < 0)
+        *p++ = '-';
+    do {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    while (n)
+        *p++ = digits[--n];
+    return p;
+}
+
+static char *put_head(char *p, char tag, INT32U t)
+{
+    signed char sh;
+
+    *p++ = tag;
+    *p++ = ' ';
+    for (sh = 20; sh >= 0; sh -= 4)
+        *p++ = pgm_read_byte(&hex[(t >> sh) & 15]);
+    return p;
+}
+
+/* ms is the hal_millis() the line is stamped with */
+static void send_at(INT32U ms, char tag, int a, int b, int c, int d, char nvals)
+{
+    char buf[40], *p;
+    INT32U t = ms - t0;
+
+    if (dropped != dropped_sent) {
+        p = put_int(put_head(buf, 'D', t), dropped);
+        *p++ = '\n';
+        if (hal_uart_write(buf, p - buf))
+            dropped_sent = dropped;
+    }
+    p = put_int(put_head(buf, tag, t), a);
+    if (nvals > 1)
+        p = put_int(p, b);
+    if (nvals > 2)
+        p = put_int(p, c);
+    if (nvals > 3)
+        p = put_int(p, d);
+    *p++ = '\n';
+    if (!hal_uart_write(buf, p - buf))
+        dropped++;
+}
+
+static void send(char tag, int a, int b, int c, int d, char nvals)
+{
+    send_at(hal_millis(), tag, a, b, c, d, nvals);
+}
+
+void tlm_start(void)
+{
+    static const char banner[] PROGMEM = "# robosample telemetry 3\n";
+    char buf[sizeof(banner)];
+
+    hal_uart_init(HAL_UBRR_38400);
+    t0 = hal_millis();
+    memcpy_P(buf, banner, sizeof(buf));
+    hal_uart_write(buf, sizeof(buf) - 1);
+}
+
+void tlm_tick(int min_us, int max_us, int mean_us)
+{
+    send('J', min_us, max_us, mean_us, 0, 3);
+}
+
+void tlm_idle(int ua, int wakes)
+{
+    send('S', ua, wakes, 0, 0, 2);
+}
+
+void tlm_wdog(int resets, int culprit)
+{
+    send('W', resets, culprit, 0, 0, 2);
+}
+
+int tlm_request(void)
+{
+    int c = hal_uart_read();
+
+    return c < 0 ? 0 : c;
+}
+
+void tlm_task(int prio, int wcrt_ms, int mean_ms, int misses)
+{
+    send('R', prio, wcrt_ms, mean_ms, misses, 4);
+}
+
+void tlm_stack(int prio, int used, int size)
+{
+    send('K', prio, used, size, 0, 3);
+}
+
+void tlm_battery(int mv, int gain, int adc)
+{
+    send('V', mv, gain, adc, 0, 3);
+}
+
+#ifdef TELEMETRY
+
+enum { TLM_LINE, TLM_LIGHT, TLM_PROX, TLM_MOTOR, TLM_CP, TLM_NTAGS };
+
+static const char tags[TLM_NTAGS] PROGMEM = { 'L', 'I', 'P', 'M', 'C' };
+
+static int    last_a[TLM_NTAGS], last_b[TLM_NTAGS], last_c[TLM_NTAGS];
+static char   sent[TLM_NTAGS];
+
+static void record_at(INT32U ms, unsigned char which, int a, int b, int c, char nvals)
+{
+    if (sent[which] && last_a[which] == a && last_b[which] == b && last_c[which] == c)
+        return;
+    sent[which] = 1;
+    last_a[which] = a;
+    last_b[which] = b;
+    last_c[which] = c;
+    send_at(ms, pgm_read_byte(&tags[which]), a, b, c, 0, nvals);
+}
+
+static void record(unsigned char which, int a, int b, int c, char nvals)
+{
+    record_at(hal_millis(), which, a, b, c, nvals);
+}
+
+int tlm_lineSensor(void)
+{
+    int v = linesens_code();
+    record(TLM_LINE, linesens_read(LS_LEFT), linesens_read(LS_MIDDLE), linesens_read(LS_RIGHT), 3);
+    return v;
+}
+
+int tlm_lightSensor(void)
+{
+    int v = adcscan_read(LIGHT_ADC);
+    record(TLM_LIGHT, v, 0, 0, 1);
+    return v;
+}
+
+int tlm_proxSensor(void)
+{
+    int v = adcscan_read(ADC_PROX) < ADC_PROX_NEAR;
+    record(TLM_PROX, v, 0, 0, 1);
+    return v;
+}
+
+void tlm_motorOut(int lspeed, int rspeed)
+{
+    record(TLM_MOTOR, lspeed, rspeed, 0, 2);
+}
+
+void tlm_motorAt(INT32U ms, int lspeed, int rspeed)
+{
+    record_at(ms, TLM_MOTOR, lspeed, rspeed, 0, 2);
+}
+
+void tlm_cpState(int state)
+{
+    record(TLM_CP, state, 0, 0, 1);
+}
+
+void tlm_bar(int confidence, int counted)
+{
+    send('B', confidence, counted, 0, 0, 2);
+}
+
+void tlm_lamp(int lamp, int on)
+{
+    send('E', lamp, on, 0, 0, 2);
+}
+
+#endif
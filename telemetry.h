@@ -0,0 +1,82 @@
+/*
+ *   TELEMETRY.H -- Sensor/motor recorder streamed over the UART
+ *
+ *   Status lines at 38400 baud: the 5 s reports (V, J, S), the watchdog
+ *   culprit after a reset (W) and the response times and stacks on request
+ *   (R, K) are always sent.  Build with -DTELEMETRY to also record every
+ *   sensor value the tasks read and every wheel output and checkpoint
+ *   change they make, one text line per event:
+ *
+ *       L tttttt l m r      line ADC counts behind linesens_code() and
+ *                           linesens_centroid()
+ *       I tttttt adc        filtered light ADC, for lightsens_update()
+ *       P tttttt 0|1        prox ADC below ADC_PROX_NEAR
+ *       M tttttt left right wheel output written by drive.c
+ *       C tttttt state      cp_state
+ *       B tttttt conf 0|1   full bar ended: confidence, counted or not
+ *       E tttttt lamp 0|1   L1 or L2 seen (1) or left behind (0)
+ *       V tttttt mV gain adc  pack voltage, drive.c PWM gain (128 = 1.0) and
+ *                           the ADC count it came from (drive.h)
+ *       J tttttt min max mean  OS tick interval in us over the last report
+ *       S tttttt uA wakes   estimated MCU current and wakes/s from sleep, likewise
+ *       W tttttt resets who after a watchdog reset: resets so far, culprit task
+ *       R tttttt prio wcrt mean misses  response time in ms of a task, on request
+ *       K tttttt prio used size  stack bytes of a task ever used, likewise
+ *       D tttttt count      lines lost to a full transmit buffer so far
+ *
+ *   tttttt is the Timer2 millisecond clock in hex, zero at tlm_start();
+ *   hal_clock_init() must already have been called.  An M line is stamped
+ *   when the output was written, which the drive.c interrupt may do while
+ *   no task can send it; it can then follow lines stamped later.
+ *   Except for B, E, V, J, S, W, R and K, which are sent for every event,
+ *   a line is only sent when the value differs from the last one sent for
+ *   that tag, which is enough to replay the run sample-and-hold (see
+ *   sim/src/replay.c).  Without TELEMETRY the sensor wrappers are the plain
+ *   sensor reads and the other per-event calls compile to nothing.
+ *
+ *   tlm_request() gives a byte received over the UART, or 0; an 'r' asks
+ *   TaskStart for the R and K lines of every task (see rtmon.h).
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "../inc/hal_robo.h"
+#include "linesens.h"
+#include "lightsens.h"
+#include "adcscan.h"
+
+void tlm_start(void);
+void tlm_battery(int mv, int gain, int adc);
+void tlm_tick(int min_us, int max_us, int mean_us);
+void tlm_idle(int ua, int wakes);
+void tlm_wdog(int resets, int culprit);
+int  tlm_request(void);
+void tlm_task(int prio, int wcrt_ms, int mean_ms, int misses);
+void tlm_stack(int prio, int used, int size);
+
+#ifdef TELEMETRY
+
+int  tlm_lineSensor(void);
+int  tlm_lightSensor(void);
+int  tlm_proxSensor(void);
+void tlm_motorOut(int lspeed, int rspeed);
+void tlm_motorAt(INT32U ms, int lspeed, int rspeed);    // hal_millis() it was written at
+void tlm_cpState(int state);
+void tlm_bar(int confidence, int counted);
+void tlm_lamp(int lamp, int on);
+
+#else
+
+#define tlm_lineSensor()            linesens_code()
+#define tlm_lightSensor()           adcscan_read(LIGHT_ADC)
+#define tlm_proxSensor()            (adcscan_read(ADC_PROX) < ADC_PROX_NEAR)
+#define tlm_motorOut(l, r)
+#define tlm_motorAt(t, l, r)
+#define tlm_cpState(s)
+#define tlm_bar(c, n)
+#define tlm_lamp(l, o)
+
+#endif
+
+#endif
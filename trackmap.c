@@ -0,0 +1,168 @@
+/*
+ *   TRACKMAP.C -- Learned segment map of the course; see trackmap.h
+ */
+
+#include "trackmap.h"
+#include "hal_ext.h"
+
+#define TM_MAGIC            0x544d      // "TM"; bump when struct tm_map changes
+
+enum { TM_STRAIGHT, TM_GENTLE, TM_SHARP, TM_NONE };
+
+struct tm_seg
+{
+    INT8U  kind;
+    INT8U  cp;
+    INT16U start;                       // distance from the bar that opened cp
+};
+
+struct tm_map
+{
+    INT16U magic;
+    INT8U  nseg;
+    INT8U  complete;
+    INT16U len[TM_NCP];                 // distance from bar to bar
+    struct tm_seg seg[TM_MAX_SEGS];
+};
+
+static struct tm_map map;
+static char   learning;
+static char   saved;
+
+static char   cur_cp;
+static INT32S acc;                      // speed x ms since the last bar
+static INT32U last_ms;
+static INT8U  pend_kind = TM_NONE;      // kind seen since pend_start
+static INT16U pend_start;
+
+static INT8U code_kind(int code)
+{
+    switch (code)
+    {
+        case 2:         return TM_STRAIGHT;
+        case 3: case 6: return TM_GENTLE;
+        case 0: case 1:
+        case 4:         return TM_SHARP;
+        default:        return TM_NONE; // 5 and 7 say nothing about the curve
+    }
+}
+
+static INT16U dist(void)
+{
+    INT32S d = acc >> TM_DIST_SHIFT;
+    return d > 0xffff ? 0xffff : (INT16U)d;
+}
+
+static void seg_open(INT8U kind, INT16U start)
+{
+    if (map.nseg == TM_MAX_SEGS) {
+        map.complete = 0;               // too many segments; never save this map
+        return;
+    }
+    map.seg[map.nseg].kind = kind;
+    map.seg[map.nseg].cp = cur_cp;
+    map.seg[map.nseg].start = start;
+    map.nseg++;
+}
+
+void trackmap_init(char forget)
+{
+    hal_eeprom_read(EE_TRACKMAP, &map, sizeof(map));
+    learning = forget || map.magic != TM_MAGIC || !map.complete;
+    if (learning) {
+        map.magic = TM_MAGIC;
+        map.nseg = 0;
+        map.complete = 1;
+    }
+    last_ms = hal_millis();
+}
+
+/* Once per Navig cycle; lspeed/rspeed are what drove the robot since the last call */
+void trackmap_step(char cp, int code, int lspeed, int rspeed)
+{
+    INT32U now = hal_millis();
+    INT8U kind;
+
+    // The bar was counted at the end of the last cycle; what was driven since is past it
+    if (cp != cur_cp) {
+        if (learning && cur_cp < TM_NCP)
+            map.len[(INT8U)cur_cp] = dist();
+        cur_cp = cp;
+        acc = 0;
+        pend_kind = TM_NONE;
+    }
+    acc += (INT32S)(lspeed + rspeed) / 2 * (INT32S)(now - last_ms);
+    if (acc < 0)
+        acc = 0;
+    last_ms = now;
+    if (!learning || cp >= TM_NCP - 1)
+        return;
+
+    kind = code_kind(code);
+    if (kind == TM_NONE)
+        return;
+    if (map.nseg == 0 || map.seg[map.nseg - 1].cp != cp) {
+        seg_open(kind, 0);
+    } else if (kind == map.seg[map.nseg - 1].kind) {
+        pend_kind = TM_NONE;
+    } else if (kind != pend_kind) {
+        pend_kind = kind;
+        pend_start = dist();
+    } else if ((INT16U)(dist() - pend_start) >= TM_MIN_SEG) {
+        seg_open(kind, pend_start);
+        pend_kind = TM_NONE;
+    }
+}
+
+char trackmap_fast(char cp, int code)
+{
+    INT16U d = dist(), end;
+    int i;
+
+    if (learning || code != 2 || cp >= TM_NCP)
+        return 0;
+    if (d > (INT32U)map.len[(INT8U)cp] + TM_SLACK)
+        return 0;                       // a bar was missed or miscounted
+    for (i = map.nseg - 1; i >= 0; i--)
+        if (map.seg[i].cp == cp && map.seg[i].start <= d)
+            break;
+    if (i < 0 || map.seg[i].kind != TM_STRAIGHT)
+        return 0;
+    if (i + 1 < map.nseg && map.seg[i + 1].cp == cp)
+        end = map.seg[i + 1].start;
+    else
+        end = map.len[(INT8U)cp];
+    return (INT32U)d + TM_BRAKE_DIST < end;
+}
+
+/* Dead-reckoned distance since the last counted bar, as of the last trackmap_step() */
+INT16U trackmap_dist(void)
+{
+    return dist();
+}
+
+/* Every interval between two bars long enough and every segment inside its
+   interval; the one from the start to the first bar depends on where the
+   robot was put down */
+static char plausible(void)
+{
+    INT8U i;
+
+    for (i = 1; i < TM_NCP - 1; i++)
+        if (map.len[i] < TM_MIN_LEN || map.len[i] == 0xffff)
+            return 0;
+    for (i = 0; i < map.nseg; i++)
+        if (map.seg[i].cp >= TM_NCP - 1 || map.seg[i].start >= map.len[map.seg[i].cp])
+            return 0;
+    return 1;
+}
+
+/* Call once the robot has stopped at the finish; the write stalls the caller */
+void trackmap_lap_done(void)
+{
+    if (!learning || saved)
+        return;
+    saved = 1;
+    if (map.complete && plausible())
+        hal_eeprom_write(EE_TRACKMAP, &map, sizeof(map));
+}
@@ -0,0 +1,37 @@
+/*
+ *   TRACKMAP.H -- Learned segment map of the course for robosample.c
+ *
+ *   The first lap is a learning lap: every interval between two bars is cut
+ *   into straight, gentle and sharp segments by the line code, with the
+ *   distance of each segment dead-reckoned from the commanded wheel speeds
+ *   (the robot has no encoders).  The map is saved to EEPROM when the lap
+ *   ends, so it survives the power cycle to the next run, unless it does
+ *   not look like a lap: an interval shorter than TM_MIN_LEN, or a segment
+ *   past the end of its interval, means a bar was counted twice or a
+ *   distance ran away, and the next run learns again.  On later runs
+ *   trackmap_fast() says where the robot may go faster: on a learned
+ *   straight, while it is centred on the line, and not within TM_BRAKE_DIST
+ *   of the next corner or bar.  Every counted bar resynchronises the
+ *   distance, so dead-reckoning errors do not accumulate over the lap.
+ */
+
+#ifndef TRACKMAP_H
+#define TRACKMAP_H
+
+#include "../inc/kernel.h"
+
+#define TM_MAX_SEGS         48          // whole course, all intervals
+#define TM_NCP              8           // one interval per CpState
+#define TM_DIST_SHIFT       7           // distance unit: speed x ms >> 7
+#define TM_MIN_SEG          60          // a new segment must last this far
+#define TM_BRAKE_DIST       120         // slow down this far before the end
+#define TM_SLACK            150         // past the learned length: out of sync
+#define TM_MIN_LEN          600         // shorter from bar to bar: one bar counted twice
+
+void trackmap_init(char forget);
+void trackmap_step(char cp, int code, int lspeed, int rspeed);
+char trackmap_fast(char cp, int code);
+void trackmap_lap_done(void);
+INT16U trackmap_dist(void);
+
+#endif
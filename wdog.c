@@ -0,0 +1,88 @@
+/*
+ *   WDOG.C -- Task supervisor over the hardware watchdog; see wdog.h
+ */
+
+#include "wdog.h"
+#include "hal_ext.h"
+#include "tasks.h"
+
+#define WDOG_MAGIC      0x5744          // "WD"; bump when struct wdog_log changes
+
+static INT16U limit[TASK_NPRIO];        // by priority, ms; 0 = not watched
+static volatile INT16U age[TASK_NPRIO];
+static volatile char   running;
+
+void wdog_watch(INT8U prio, INT16U ms)
+{
+    unsigned char sreg;
+
+    if (prio >= TASK_NPRIO)
+        return;
+    sreg = hal_irq_save();
+
+    limit[prio] = ms;
+    age[prio] = 0;
+    hal_irq_restore(sreg);
+}
+
+void wdog_start(void)
+{
+    hal_wdt_start();
+    running = 1;
+}
+
+void wdog_checkin(INT8U prio)
+{
+    unsigned char sreg;
+
+    if (prio >= TASK_NPRIO)
+        return;
+    sreg = hal_irq_save();
+
+    age[prio] = 0;
+    hal_irq_restore(sreg);
+}
+
+void wdog_isr(void)
+{
+    INT8U p;
+
+    if (!running)
+        return;
+    for (p = 0; p < TASK_NPRIO; p++) {
+        if (limit[p] && ++age[p] > limit[p]) {
+            running = 0;
+            hal_wdt_trip(p);
+            return;
+        }
+    }
+    hal_wdt_kick();
+}
+
+INT8U wdog_boot(void)
+{
+    struct wdog_log log;
+    INT8U who = hal_wdt_culprit();
+
+    if (who == HAL_WDT_NONE)
+        return WDOG_NONE;
+    if (who >= TASK_NPRIO)
+        who = WDOG_UNKNOWN;
+    wdog_log(&log);
+    if (log.resets < 0xff)
+        log.resets++;
+    log.culprit = who;
+    hal_eeprom_write(EE_WDOG, &log, sizeof(log));
+    return who;
+}
+
+/* Cleared if there is none yet */
+void wdog_log(struct wdog_log *log)
+{
+    hal_eeprom_read(EE_WDOG, log, sizeof(*log));
+    if (log->magic != WDOG_MAGIC) {
+        log->magic = WDOG_MAGIC;
+        log->resets = 0;
+        log->culprit = WDOG_NONE;
+    }
+}
@@ -0,0 +1,41 @@
+/*
+ *   WDOG.H -- Task supervisor over the hardware watchdog
+ *
+ *   Each watched task calls wdog_checkin() every time round its loop and
+ *   must do so again within the deadline wdog_watch() gave it.  The Timer2
+ *   interrupt calls wdog_isr() every millisecond; it kicks the hardware
+ *   watchdog only while every watched task is within its deadline.  Once
+ *   one is not, it resets the board through hal_wdt_trip(), naming the
+ *   task, so a task stuck with the wheels running stops them.  A lockup
+ *   with interrupts off stops the kicks too; the watchdog then resets the
+ *   board after HAL_WDT_TIMEOUT_MS with no culprit.
+ *
+ *   After a watchdog reset wdog_boot() counts it in an EEPROM log, with
+ *   the culprit, for the post-mortem.  Deadlines must cover the longest
+ *   legitimate block of the task, including time lost to higher priority
+ *   tasks (a honk busy-waits 600 ms).
+ */
+
+#ifndef WDOG_H
+#define WDOG_H
+
+#include "../inc/kernel.h"
+
+#define WDOG_NONE           0xff        // wdog_boot(): no watchdog reset
+#define WDOG_UNKNOWN        0xfe        // a watchdog reset with no task named
+
+struct wdog_log
+{
+    INT16U magic;
+    INT8U  resets;                      // watchdog resets so far, saturating
+    INT8U  culprit;                     // task priority, or WDOG_UNKNOWN
+};
+
+void  wdog_watch(INT8U prio, INT16U ms);     // prio from tasks.h; above every task there, ignored
+void  wdog_start(void);                 // supervise and run the hardware watchdog
+void  wdog_checkin(INT8U prio);
+void  wdog_isr(void);
+INT8U wdog_boot(void);                  // before wdog_start(); logs a watchdog reset, gives its culprit
+void  wdog_log(struct wdog_log *log);
+
+#endif